@@ -0,0 +1,604 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <omp.h>
+#include <unistd.h>
+#include "pagerank.h"
+
+// Benchmark driver: solves one graph with each engine at each thread count,
+// repetitions times after warmup untimed runs, and reports the median, min
+// and standard deviation of the solve time together with the time per
+// iteration, edge traversals per second, memory bandwidth and hardware
+// counters. Loading and reordering the graph are timed separately. Built
+// with -DPAGERANK_PROFILE=1, it also breaks the time and counters down by
+// phase.
+
+#define DEFAULT_THREAD_COUNTS "1,2,4,6,8,10,12,16,20,32,64"
+#define DEFAULT_REPETITIONS 5
+#define DEFAULT_WARMUP 1
+#define DEFAULT_OUTPUT "pagerank_results.csv"
+
+// Thread counts and engines accepted in one run.
+#define MAX_LIST 64
+
+// CSV headings and JSON keys of the hardware counters, in Counter order.
+const char *const counterColumns[] = {"Cycles", "Instructions", "LLC Misses"};
+const char *const counterKeys[] = {"cycles", "instructions", "llc_misses"};
+
+// One engine at one thread count. times holds every timed repetition; stats,
+// bandwidth and events are those of the median one (events are NAN where a
+// counter did not open), as are the per-phase figures of profiling builds.
+typedef struct
+{
+    Engine engine;
+    int threads;
+    double *times;
+    double median;
+    double min;
+    double stddev;
+    Stats stats;
+    double modelBytes;
+    double *socketBytes;
+    double events[COUNTER_COUNT];
+    double phaseTime[PHASE_COUNT];
+    double phaseEvents[PHASE_COUNT][COUNTER_COUNT];
+    double phaseBytes[PHASE_COUNT];
+} Measurement;
+
+int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Parses a comma-separated list of positive integers; returns the count, or
+// 0 if an entry is not one.
+int parseIntList(const char *list, int *values, int capacity)
+{
+    int count = 0;
+    while (*list && count < capacity)
+    {
+        char *end;
+        long value = strtol(list, &end, 10);
+        if (end == list || value <= 0 || value > 1 << 20 || (*end != ',' && *end != '\0'))
+        {
+            return 0;
+        }
+        values[count++] = (int)value;
+        list = *end == ',' ? end + 1 : end;
+    }
+    return *list ? 0 : count;
+}
+
+// Parses a comma-separated list of engine names; returns the count, or 0 if
+// a name is unknown.
+int parseEngineList(const char *list, Engine *engines, int capacity)
+{
+    char name[64];
+    int count = 0;
+    while (*list && count < capacity)
+    {
+        int length = (int)strcspn(list, ",");
+        if (length >= (int)sizeof(name))
+        {
+            return 0;
+        }
+        memcpy(name, list, length);
+        name[length] = '\0';
+        int index = parseName(name, engineNames, sizeof(engineNames) / sizeof(engineNames[0]));
+        if (index < 0)
+        {
+            return 0;
+        }
+        engines[count++] = (Engine)index;
+        list += length;
+        list += *list == ',';
+    }
+    return *list ? 0 : count;
+}
+
+// Bytes an engine must move at least: the offsets, out-degrees and three
+// rank-sized double vectors (old and new ranks, contributions) once per
+// iteration, plus one source index per edge traversed. The real traffic is
+// higher whenever the ranks gathered do not stay in cache.
+double modelBytes(Graph *g, Stats stats, int startIteration)
+{
+    double sweeps = stats.iterations - startIteration;
+    return sweeps * g->n * (2.0 * sizeof(int) + 3.0 * sizeof(double)) + (double)stats.edgeTraversals * sizeof(int);
+}
+
+// Runs warmup untimed solves and then the timed repetitions of one
+// measurement. Each repetition is a complete solve from the initial ranks.
+// counters and bandwidth, either of which may be NULL, are read around each
+// repetition, and in profiling builds at each phase boundary too.
+void measure(Graph *g, Options *options, int repetitions, int warmup,
+             PerfCounters *counters, BandwidthCounters *bandwidth, Measurement *m)
+{
+    int sockets = bandwidth ? bandwidth->sockets : 0;
+    Stats *stats = (Stats *)malloc(repetitions * sizeof(Stats));
+    double *bytes = (double *)calloc((size_t)repetitions * sockets + 2 * sockets + 1, sizeof(double));
+    double *before = bytes + (size_t)repetitions * sockets, *after = before + sockets;
+    double (*events)[COUNTER_COUNT] = calloc(repetitions, sizeof(*events));
+    Profile *phases = (Profile *)calloc(repetitions, sizeof(Profile));
+    Profile profile;
+
+    memset(&profile, 0, sizeof(profile));
+    profile.counters = counters;
+    profile.bandwidth = bandwidth;
+    options->engine = m->engine;
+    options->threads = m->threads;
+    options->profile = NULL;
+    for (int r = 0; r < warmup; r++)
+    {
+        computePageRank(g, options, NULL);
+    }
+    if (PAGERANK_PROFILE)
+    {
+        options->profile = &profile;
+    }
+    for (int r = 0; r < repetitions; r++)
+    {
+        double eventsBefore[COUNTER_COUNT] = {0.0}, eventsAfter[COUNTER_COUNT] = {0.0};
+        if (counters)
+        {
+            readPerfCounters(counters, eventsBefore);
+        }
+        if (bandwidth)
+        {
+            memset(before, 0, 2 * sockets * sizeof(double));
+            readBandwidthCounters(bandwidth, before);
+        }
+        double start_time = omp_get_wtime();
+        stats[r] = computePageRank(g, options, NULL);
+        m->times[r] = omp_get_wtime() - start_time;
+        if (bandwidth)
+        {
+            readBandwidthCounters(bandwidth, after);
+            for (int k = 0; k < sockets; k++)
+            {
+                bytes[(size_t)r * sockets + k] = after[k] - before[k];
+            }
+        }
+        if (counters)
+        {
+            readPerfCounters(counters, eventsAfter);
+        }
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            events[r][c] = counters && counters->available[c] ? eventsAfter[c] - eventsBefore[c] : NAN;
+        }
+        phases[r] = profile;
+    }
+    options->profile = NULL;
+    freeProfile(&profile);
+
+    double *sorted = (double *)malloc(repetitions * sizeof(double));
+    memcpy(sorted, m->times, repetitions * sizeof(double));
+    qsort(sorted, repetitions, sizeof(double), compareDoubles);
+    m->min = sorted[0];
+    m->median = repetitions % 2 ? sorted[repetitions / 2] :
+                (sorted[repetitions / 2 - 1] + sorted[repetitions / 2]) / 2;
+
+    double mean = 0.0, variance = 0.0;
+    for (int r = 0; r < repetitions; r++)
+    {
+        mean += m->times[r] / repetitions;
+    }
+    for (int r = 0; r < repetitions; r++)
+    {
+        variance += (m->times[r] - mean) * (m->times[r] - mean);
+    }
+    m->stddev = repetitions > 1 ? sqrt(variance / (repetitions - 1)) : 0.0;
+
+    // The repetition closest to the median stands for the measurement.
+    int chosen = 0;
+    for (int r = 1; r < repetitions; r++)
+    {
+        if (fabs(m->times[r] - m->median) < fabs(m->times[chosen] - m->median))
+        {
+            chosen = r;
+        }
+    }
+    m->stats = stats[chosen];
+    m->modelBytes = modelBytes(g, stats[chosen], options->startIteration);
+    for (int k = 0; k < sockets; k++)
+    {
+        m->socketBytes[k] = bytes[(size_t)chosen * sockets + k];
+    }
+    memcpy(m->events, events[chosen], sizeof(m->events));
+    memcpy(m->phaseTime, phases[chosen].phaseTime, sizeof(m->phaseTime));
+    memcpy(m->phaseEvents, phases[chosen].phaseEvents, sizeof(m->phaseEvents));
+    memcpy(m->phaseBytes, phases[chosen].phaseBytes, sizeof(m->phaseBytes));
+
+    free(sorted);
+    free(stats);
+    free(bytes);
+    free(events);
+    free(phases);
+}
+
+// Writes value, or nothing for a counter that did not open.
+void writeCsvValue(FILE *fout, double value)
+{
+    if (isnan(value))
+    {
+        fprintf(fout, ",");
+    }
+    else
+    {
+        fprintf(fout, ",%.0f", value);
+    }
+}
+
+// The per-phase headings of profiling builds, e.g. "Update Time".
+void writePhaseHeadings(FILE *fout, int sockets)
+{
+    for (int phase = 0; phase < PHASE_COUNT && PAGERANK_PROFILE; phase++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%s", phaseNames[phase]);
+        name[0] = (char)toupper((unsigned char)name[0]);
+        fprintf(fout, ",%s Time", name);
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            fprintf(fout, ",%s %s", name, counterColumns[c]);
+        }
+        if (sockets > 0)
+        {
+            fprintf(fout, ",%s GB/s", name);
+        }
+    }
+}
+
+void writePhaseValues(FILE *fout, const Measurement *m, int sockets)
+{
+    for (int phase = 0; phase < PHASE_COUNT && PAGERANK_PROFILE; phase++)
+    {
+        fprintf(fout, ",%f", m->phaseTime[phase]);
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            writeCsvValue(fout, isnan(m->events[c]) ? NAN : m->phaseEvents[phase][c]);
+        }
+        if (sockets > 0)
+        {
+            fprintf(fout, ",%f", m->phaseTime[phase] > 0.0 ? m->phaseBytes[phase] / m->phaseTime[phase] / 1e9 : 0.0);
+        }
+    }
+}
+
+// Writes value as a JSON number, or null for a counter that did not open.
+void writeJsonValue(FILE *fout, const char *name, double value)
+{
+    if (isnan(value))
+    {
+        fprintf(fout, ", \"%s\": null", name);
+    }
+    else
+    {
+        fprintf(fout, ", \"%s\": %.0f", name, value);
+    }
+}
+
+// The CSV for engine: output itself when only one engine is measured, or
+// output with "_<engine>" inserted before its extension otherwise.
+char *csvName(const char *output, Engine engine, int engineCount)
+{
+    size_t length = strlen(output) + strlen(engineNames[engine]) + 2;
+    char *name = (char *)malloc(length);
+    if (engineCount == 1)
+    {
+        strcpy(name, output);
+        return name;
+    }
+    const char *dot = strrchr(output, '.');
+    int stem = dot && !strchr(dot, '/') ? (int)(dot - output) : (int)strlen(output);
+    snprintf(name, length, "%.*s_%s%s", stem, output, engineNames[engine], output + stem);
+    return name;
+}
+
+// Writes s as a JSON string literal.
+void writeJsonString(FILE *fout, const char *s)
+{
+    fputc('"', fout);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fprintf(fout, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(fout, "\\u%04x", *s);
+        }
+        else
+        {
+            fputc(*s, fout);
+        }
+    }
+    fputc('"', fout);
+}
+
+void writeJson(const char *filename, const char *graphFile, Graph *g, double loadTime, const Options *options,
+               int repetitions, int warmup, Measurement *results, int count, int sockets)
+{
+    FILE *fout = fopen(filename, "w");
+    if (!fout)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return;
+    }
+    fprintf(fout, "{\n  \"graph\": ");
+    writeJsonString(fout, graphFile);
+    fprintf(fout, ",\n  \"vertices\": %d,\n  \"edges\": %d,\n  \"load_time\": %f,\n", g->n, g->edges, loadTime);
+    fprintf(fout, "  \"precision\": \"%s\",\n  \"max_iterations\": %d,\n  \"repetitions\": %d,\n  \"warmup\": %d,\n",
+            precisionNames[RANK_PRECISION], options->maxIterations, repetitions, warmup);
+    fprintf(fout, "  \"results\": [\n");
+    for (int i = 0; i < count; i++)
+    {
+        Measurement *m = &results[i];
+        int sweeps = m->stats.iterations - options->startIteration;
+        fprintf(fout, "    {\"engine\": \"%s\", \"threads\": %d, \"times\": [", engineNames[m->engine], m->threads);
+        for (int r = 0; r < repetitions; r++)
+        {
+            fprintf(fout, "%s%f", r ? ", " : "", m->times[r]);
+        }
+        fprintf(fout, "],\n     \"median\": %f, \"min\": %f, \"stddev\": %f, \"iterations\": %d, \"edge_traversals\": %lld,\n",
+                m->median, m->min, m->stddev, m->stats.iterations, m->stats.edgeTraversals);
+        fprintf(fout, "     \"time_per_iteration\": %e, \"gteps\": %f, \"model_gbps\": %f, \"socket_gbps\": [",
+                m->median / (sweeps > 0 ? sweeps : 1), m->stats.edgeTraversals / m->median / 1e9,
+                m->modelBytes / m->median / 1e9);
+        for (int k = 0; k < sockets; k++)
+        {
+            fprintf(fout, "%s%f", k ? ", " : "", m->socketBytes[k] / m->median / 1e9);
+        }
+        fprintf(fout, "]");
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            writeJsonValue(fout, counterKeys[c], m->events[c]);
+        }
+        if (PAGERANK_PROFILE)
+        {
+            fprintf(fout, ",\n     \"phases\": [");
+            for (int phase = 0; phase < PHASE_COUNT; phase++)
+            {
+                fprintf(fout, "%s{\"phase\": \"%s\", \"time\": %f", phase ? ", " : "",
+                        phaseNames[phase], m->phaseTime[phase]);
+                for (int c = 0; c < COUNTER_COUNT; c++)
+                {
+                    writeJsonValue(fout, counterKeys[c], isnan(m->events[c]) ? NAN : m->phaseEvents[phase][c]);
+                }
+                writeJsonValue(fout, "bytes", sockets > 0 ? m->phaseBytes[phase] : NAN);
+                fprintf(fout, "}");
+            }
+            fprintf(fout, "]");
+        }
+        fprintf(fout, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(fout, "  ]\n}\n");
+    fclose(fout);
+}
+
+void printUsage(const char *program)
+{
+    printf("Usage: %s [-e engines] [-t threads] [-n repetitions] [-W warmup] [-i iterations]\n"
+           "       [-o results.csv] [-j results.json] [-O ordering] [solver options] graph\n", program);
+    printf("  -e  comma-separated engines:");
+    for (int i = 0; i < (int)(sizeof(engineNames) / sizeof(engineNames[0])); i++)
+    {
+        printf(" %s", engineNames[i]);
+    }
+    printf(" (default %s)\n", engineNames[ENGINE_BASELINE]);
+    printf("  -t  comma-separated thread counts (default %s)\n", DEFAULT_THREAD_COUNTS);
+    printf("  -n  timed solves per engine and thread count (default %d)\n", DEFAULT_REPETITIONS);
+    printf("  -W  untimed warm-up solves before them (default %d)\n", DEFAULT_WARMUP);
+    printf("  -i  iteration limit (default %d)\n", MAX_ITERATIONS);
+    printf("  -o  CSV file, with _<engine> added for several engines (default %s)\n", DEFAULT_OUTPUT);
+    printf("  -j  also write every measurement to this JSON file\n");
+    printf("  -O  relabel vertices for locality before solving:");
+    for (int i = 0; i < (int)(sizeof(orderingNames) / sizeof(orderingNames[0])); i++)
+    {
+        printf(" %s", orderingNames[i]);
+    }
+    printf(" (default %s)\n", orderingNames[ORDER_NONE]);
+    printSolverOptions();
+}
+
+int main(int argc, char *argv[])
+{
+    Engine engines[MAX_LIST] = {ENGINE_BASELINE};
+    int threadCounts[MAX_LIST];
+    int engineCount = 1;
+    int threadCount = parseIntList(DEFAULT_THREAD_COUNTS, threadCounts, MAX_LIST);
+    int repetitions = DEFAULT_REPETITIONS, warmup = DEFAULT_WARMUP;
+    const char *output = DEFAULT_OUTPUT, *jsonFile = NULL;
+    Ordering ordering = ORDER_NONE;
+    Options options;
+    int opt, index;
+
+    initOptions(&options);
+    while ((opt = getopt(argc, argv, "e:t:n:W:i:o:j:O:" SOLVER_OPTIONS)) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            engineCount = parseEngineList(optarg, engines, MAX_LIST);
+            break;
+        case 't':
+            threadCount = parseIntList(optarg, threadCounts, MAX_LIST);
+            break;
+        case 'n':
+            repetitions = atoi(optarg);
+            break;
+        case 'W':
+            warmup = atoi(optarg);
+            break;
+        case 'i':
+            options.maxIterations = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'j':
+            jsonFile = optarg;
+            break;
+        case 'O':
+            index = parseName(optarg, orderingNames, sizeof(orderingNames) / sizeof(orderingNames[0]));
+            if (index < 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            ordering = (Ordering)index;
+            break;
+        default:
+            if (parseSolverOption(&options, opt, optarg) <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    if (optind + 1 != argc || engineCount == 0 || threadCount == 0 || repetitions <= 0 || warmup < 0 ||
+        options.maxIterations <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    double start_time = omp_get_wtime();
+    Graph *g = readGraph(argv[optind]);
+    double load_time = omp_get_wtime() - start_time;
+    if (!g)
+    {
+        return 1;
+    }
+    printf("Loaded %d vertices and %d edges in %f s\n", g->n, g->edges, load_time);
+    if (ordering != ORDER_NONE)
+    {
+        start_time = omp_get_wtime();
+        Graph *reordered = reorderGraph(g, ordering);
+        printf("Reordered vertices by %s in %f s\n", orderingNames[ordering], omp_get_wtime() - start_time);
+        freeGraph(g);
+        g = reordered;
+    }
+    printf("Using %s gather kernel with %s precision\n",
+           kernelNames[selectKernel(options.kernel)], precisionNames[RANK_PRECISION]);
+
+    BandwidthCounters *bandwidth = openBandwidthCounters();
+    int sockets = bandwidth ? bandwidth->sockets : 0;
+    if (!bandwidth)
+    {
+        printf("Per-socket memory bandwidth counters are not available\n");
+    }
+
+    Measurement *results = (Measurement *)calloc((size_t)engineCount * threadCount, sizeof(Measurement));
+    int warned = 0, failed = 0;
+    for (int e = 0; e < engineCount; e++)
+    {
+        char *filename = csvName(output, engines[e], engineCount);
+        FILE *fout = fopen(filename, "w");
+        if (!fout)
+        {
+            printf("Error: Could not open file %s\n", filename);
+            free(filename);
+            failed = 1;
+            break;
+        }
+        // Counter columns are left empty where the counters do not open.
+        fprintf(fout, "Threads,Time,Speedup,Parallel Fraction,Cycles,Instructions,IPC,LLC Misses,Iterations,"
+                      "Edge Traversals,Min Time,Stddev,Time per Iteration,GTEPS,Model GB/s");
+        for (int k = 0; k < sockets; k++)
+        {
+            fprintf(fout, ",Socket %d GB/s", k);
+        }
+        writePhaseHeadings(fout, sockets);
+        fprintf(fout, "\n");
+
+        // Speedup and parallel fraction are relative to the first thread count.
+        for (int j = 0; j < threadCount; j++)
+        {
+            Measurement *m = &results[(size_t)e * threadCount + j];
+            m->engine = engines[e];
+            m->threads = threadCounts[j];
+            m->times = (double *)malloc(repetitions * sizeof(double));
+            m->socketBytes = (double *)calloc(sockets + 1, sizeof(double));
+            PerfCounters *counters = openPerfCounters(m->threads);
+            if (!counters && !warned)
+            {
+                printf("Hardware performance counters are not available\n");
+                warned = 1;
+            }
+            measure(g, &options, repetitions, warmup, counters, bandwidth, m);
+            if (counters)
+            {
+                closePerfCounters(counters);
+            }
+
+            Measurement *first = &results[(size_t)e * threadCount];
+            double speedup = first->median / m->median;
+            double scale = 1.0 - (double)first->threads / m->threads;
+            double parallel_fraction = scale != 0.0 ? (1 - (1 / speedup)) / scale : 0.0;
+            int sweeps = m->stats.iterations - options.startIteration;
+            double per_iteration = m->median / (sweeps > 0 ? sweeps : 1);
+            double gteps = m->stats.edgeTraversals / m->median / 1e9;
+            double model = m->modelBytes / m->median / 1e9;
+            double ipc = m->events[COUNTER_INSTRUCTIONS] / m->events[COUNTER_CYCLES];
+
+            fprintf(fout, "%d,%f,%f,%f", m->threads, m->median, speedup, parallel_fraction);
+            writeCsvValue(fout, m->events[COUNTER_CYCLES]);
+            writeCsvValue(fout, m->events[COUNTER_INSTRUCTIONS]);
+            fprintf(fout, isnan(ipc) ? "," : ",%f", ipc);
+            writeCsvValue(fout, m->events[COUNTER_LLC_MISSES]);
+            fprintf(fout, ",%d,%lld,%f,%f,%e,%f,%f", m->stats.iterations, m->stats.edgeTraversals,
+                    m->min, m->stddev, per_iteration, gteps, model);
+            printf("%s: Threads = %d, Median = %f, Min = %f, Stddev = %f, Speedup = %f, Iterations = %d, "
+                   "Time per Iteration = %e, GTEPS = %f, Model = %f GB/s",
+                   engineNames[m->engine], m->threads, m->median, m->min, m->stddev, speedup,
+                   m->stats.iterations, per_iteration, gteps, model);
+            for (int c = 0; c < COUNTER_COUNT; c++)
+            {
+                if (!isnan(m->events[c]))
+                {
+                    printf(", %s = %.0f", counterColumns[c], m->events[c]);
+                }
+            }
+            if (!isnan(ipc))
+            {
+                printf(", IPC = %f", ipc);
+            }
+            for (int k = 0; k < sockets; k++)
+            {
+                double rate = m->socketBytes[k] / m->median / 1e9;
+                fprintf(fout, ",%f", rate);
+                printf(", Socket %d = %f GB/s", k, rate);
+            }
+            writePhaseValues(fout, m, sockets);
+            fprintf(fout, "\n");
+            printf("\n");
+        }
+        fclose(fout);
+        printf("Wrote %s\n", filename);
+        free(filename);
+    }
+
+    if (jsonFile && !failed)
+    {
+        writeJson(jsonFile, argv[optind], g, load_time, &options, repetitions, warmup,
+                  results, engineCount * threadCount, sockets);
+    }
+
+    for (int i = 0; i < engineCount * threadCount; i++)
+    {
+        free(results[i].times);
+        free(results[i].socketBytes);
+    }
+    free(results);
+    if (bandwidth)
+    {
+        closeBandwidthCounters(bandwidth);
+    }
+    freeGraph(g);
+    return failed;
+}
@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pagerank.h"
+
+// Converts a text edge list ("n edges" followed by "u v" lines) into the
+// binary CSR format described in graph_binary.h. The edge list is parsed by
+// the library loader, which leaves every column sorted by source.
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <input.txt> <output.bin>\n", argv[0]);
+        return 1;
+    }
+
+    Graph *g = readGraphFromFile(argv[1]);
+    if (!g)
+    {
+        return 1;
+    }
+    int status = writeGraphBinary(g, argv[2]) ? 0 : 1;
+    if (status == 0)
+    {
+        printf("Wrote %d vertices and %d edges to %s\n", g->n, g->edges, argv[2]);
+    }
+
+    freeGraph(g);
+    return status;
+}
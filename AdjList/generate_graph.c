@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+#include <unistd.h>
+#include "pagerank.h"
+
+// Generates synthetic graphs in parallel and writes them as a text edge list
+// or, with -b, as a binary CSR file. Every edge draws its random numbers from
+// a stream derived from the seed and the edge's index, so a seed gives the
+// same graph with any number of threads. Self-loops are never generated;
+// repeated edges are kept, as the loaders accept them.
+
+typedef enum
+{
+    MODEL_RMAT,
+    MODEL_BA,
+    MODEL_UNIFORM
+} Model;
+
+const char *const modelNames[] = {"rmat", "ba", "uniform"};
+
+// Graph500 R-MAT quadrant probabilities; d is 1 - a - b - c.
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+// Draws per preferential-attachment edge before falling back to a uniform
+// target; only the first vertex's edges can run out of other endpoints.
+#define BA_ATTEMPTS 16
+
+// Edges formatted per pass when writing text, and the longest edge line.
+#define TEXT_CHUNK_EDGES (1 << 22)
+#define MAX_EDGE_LINE 24
+
+// SplitMix64 finalizer, used both to derive streams and to step them.
+uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t nextRandom(uint64_t *state)
+{
+    *state += 0x9E3779B97F4A7C15ULL;
+    return mix64(*state);
+}
+
+// Independent stream for item index.
+uint64_t streamFor(uint64_t seed, uint64_t index)
+{
+    return mix64(seed ^ mix64(index + 0x9E3779B97F4A7C15ULL));
+}
+
+double nextReal(uint64_t *state)
+{
+    return (nextRandom(state) >> 11) * 0x1.0p-53;
+}
+
+// R-MAT: each of the scale bits of an edge's source and destination picks a
+// quadrant of the adjacency matrix with probabilities a, b, c and d, which
+// gives the skewed, community-like degrees of Kronecker graphs. Edges that
+// fall past n or on the diagonal are drawn again.
+void rmatEdge(uint64_t *state, int n, int scale, const double *p, int *src, int *dst)
+{
+    uint64_t u, v;
+    do
+    {
+        u = v = 0;
+        for (int bit = 0; bit < scale; bit++)
+        {
+            double r = nextReal(state);
+            u = (u << 1) | (r >= p[0] + p[1]);
+            v = (v << 1) | ((r >= p[0] && r < p[0] + p[1]) || r >= p[0] + p[1] + p[2]);
+        }
+    } while (u >= (uint64_t)n || v >= (uint64_t)n || u == v);
+    *src = (int)u;
+    *dst = (int)v;
+}
+
+// Preferential attachment (Barabasi-Albert) in the form of Sanders and
+// Schulz: edge e leaves vertex e / m and points at a copy of an endpoint of
+// an earlier edge, endpoint 2i being the source of edge i and 2i + 1 its
+// target. A uniform endpoint picks each vertex in proportion to its degree so
+// far. A copied target is found by redoing that edge's draws from its own
+// stream, so threads need not see each other's edges.
+int baTarget(uint64_t seed, long long e, int m, int n)
+{
+    int source = (int)(e / m);
+    uint64_t state = streamFor(seed, e);
+    for (int attempt = 0; attempt < BA_ATTEMPTS && e > 0; attempt++)
+    {
+        long long endpoint = (long long)(nextRandom(&state) % (uint64_t)(2 * e));
+        int target = endpoint % 2 == 0 ? (int)(endpoint / 2 / m) : baTarget(seed, endpoint / 2, m, n);
+        if (target != source)
+        {
+            return target;
+        }
+    }
+    int target = (int)(nextRandom(&state) % (uint64_t)(n - 1));
+    return target + (target >= source);
+}
+
+void uniformEdge(uint64_t *state, int n, int *src, int *dst)
+{
+    do
+    {
+        *src = (int)(nextRandom(state) % (uint64_t)n);
+        *dst = (int)(nextRandom(state) % (uint64_t)n);
+    } while (*src == *dst);
+}
+
+// Relabels the vertices with a seeded random permutation, so that the
+// models' hubs (the low IDs) are not also neighbours in memory.
+void permuteVertices(int n, int edges, int *src, int *dst, uint64_t seed)
+{
+    int *label = (int *)malloc(n * sizeof(int));
+    uint64_t state = streamFor(seed, UINT64_MAX);
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        label[i] = i;
+    }
+    for (i = n - 1; i > 0; i--)
+    {
+        int j = (int)(nextRandom(&state) % (uint64_t)(i + 1));
+        int t = label[i];
+        label[i] = label[j];
+        label[j] = t;
+    }
+    #pragma omp parallel for shared(src, dst, label) private(i)
+    for (i = 0; i < edges; i++)
+    {
+        src[i] = label[src[i]];
+        dst[i] = label[dst[i]];
+    }
+    free(label);
+}
+
+void generateEdges(Model model, int n, int edges, const double *p, uint64_t seed, int *src, int *dst)
+{
+    int scale = 0, m = (int)(((long long)edges + n - 1) / n), i;
+    while ((1LL << scale) < n)
+    {
+        scale++;
+    }
+
+    // Each edge has its own stream, so the schedule does not change the graph.
+    #pragma omp parallel for shared(src, dst, p) private(i) schedule(dynamic, 4096)
+    for (i = 0; i < edges; i++)
+    {
+        uint64_t state = streamFor(seed, i);
+        if (model == MODEL_RMAT)
+        {
+            rmatEdge(&state, n, scale, p, &src[i], &dst[i]);
+        }
+        else if (model == MODEL_BA)
+        {
+            src[i] = i / m;
+            dst[i] = baTarget(seed, i, m, n);
+        }
+        else
+        {
+            uniformEdge(&state, n, &src[i], &dst[i]);
+        }
+    }
+}
+
+char *formatInt(char *out, int value)
+{
+    char digits[12];
+    int count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0)
+    {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+// Writes the "n edges" header and one "u v" line per edge. Each pass formats
+// a chunk of edges in parallel, one slice per thread, and writes the slices
+// in order.
+int writeEdgeList(const char *filename, int n, int edges, const int *src, const int *dst)
+{
+    FILE *fout = fopen(filename, "w");
+    if (!fout)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return 0;
+    }
+    int chunk = edges < TEXT_CHUNK_EDGES ? (edges > 0 ? edges : 1) : TEXT_CHUNK_EDGES;
+    char *buffer = (char *)malloc((size_t)chunk * MAX_EDGE_LINE);
+    size_t *lengths = (size_t *)calloc(omp_get_max_threads(), sizeof(size_t));
+    int slices = 1;
+    int ok = fprintf(fout, "%d %d\n", n, edges) > 0;
+
+    for (int begin = 0; ok && begin < edges; begin += chunk)
+    {
+        int count = edges - begin < chunk ? edges - begin : chunk;
+        #pragma omp parallel shared(buffer, lengths, slices, src, dst)
+        {
+            int t = omp_get_thread_num(), threads = omp_get_num_threads();
+            int from = (int)((long long)count * t / threads), to = (int)((long long)count * (t + 1) / threads);
+            char *start = buffer + (size_t)from * MAX_EDGE_LINE, *out = start;
+            for (int i = begin + from; i < begin + to; i++)
+            {
+                out = formatInt(out, src[i]);
+                *out++ = ' ';
+                out = formatInt(out, dst[i]);
+                *out++ = '\n';
+            }
+            lengths[t] = out - start;
+            if (t == 0)
+            {
+                slices = threads;
+            }
+        }
+        for (int t = 0; ok && t < slices; t++)
+        {
+            const char *start = buffer + (size_t)((long long)count * t / slices) * MAX_EDGE_LINE;
+            ok = fwrite(start, 1, lengths[t], fout) == lengths[t];
+        }
+    }
+    if (fclose(fout) != 0)
+    {
+        ok = 0;
+    }
+    if (!ok)
+    {
+        printf("Error: Could not write file %s\n", filename);
+    }
+    free(lengths);
+    free(buffer);
+    return ok;
+}
+
+// Parses a non-negative int, or returns -1.
+int parseCount(const char *arg)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+    return end != arg && *end == '\0' && value >= 0 && value <= 2147483647L ? (int)value : -1;
+}
+
+void printUsage(const char *program)
+{
+    printf("Usage: %s [-m model] [-s seed] [-r a,b,c] [-t threads] [-k] [-b] vertices edges output\n", program);
+    printf("  -m  rmat (R-MAT/Kronecker), ba (preferential attachment) or uniform (default rmat)\n");
+    printf("  -s  random seed (default 1); a seed gives the same graph for any thread count\n");
+    printf("  -r  R-MAT quadrant probabilities a,b,c (default %g,%g,%g)\n", RMAT_A, RMAT_B, RMAT_C);
+    printf("  -t  threads (default all)\n");
+    printf("  -k  keep the model's vertex IDs instead of shuffling them\n");
+    printf("  -b  write the binary CSR format instead of a text edge list\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Model model = MODEL_RMAT;
+    double p[3] = {RMAT_A, RMAT_B, RMAT_C};
+    uint64_t seed = 1;
+    int keepIds = 0, binary = 0;
+    int opt, index;
+
+    while ((opt = getopt(argc, argv, "m:s:r:t:kb")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            index = parseName(optarg, modelNames, sizeof(modelNames) / sizeof(modelNames[0]));
+            if (index < 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            model = (Model)index;
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            if (sscanf(optarg, "%lf,%lf,%lf", &p[0], &p[1], &p[2]) != 3 ||
+                p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] + p[1] + p[2] >= 1)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            break;
+        case 't':
+            if (atoi(optarg) <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            omp_set_num_threads(atoi(optarg));
+            break;
+        case 'k':
+            keepIds = 1;
+            break;
+        case 'b':
+            binary = 1;
+            break;
+        default:
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    int n = optind + 3 == argc ? parseCount(argv[optind]) : -1;
+    int edges = optind + 3 == argc ? parseCount(argv[optind + 1]) : -1;
+    if (n < 2 || edges < 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const char *output = argv[optind + 2];
+
+    int *src = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+    int *dst = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+    if (!src || !dst)
+    {
+        printf("Error: Could not allocate %d edges\n", edges);
+        return 1;
+    }
+
+    double start_time = omp_get_wtime();
+    generateEdges(model, n, edges, p, seed, src, dst);
+    if (!keepIds && model != MODEL_UNIFORM)
+    {
+        permuteVertices(n, edges, src, dst, seed);
+    }
+    printf("Generated %s graph with %d vertices and %d edges in %f s\n",
+           modelNames[model], n, edges, omp_get_wtime() - start_time);
+
+    start_time = omp_get_wtime();
+    int ok;
+    if (binary)
+    {
+        Graph *g = buildGraph(n, edges, src, dst);
+        free(src);
+        free(dst);
+        src = dst = NULL;
+        ok = g && writeGraphBinary(g, output);
+        if (g)
+        {
+            freeGraph(g);
+        }
+    }
+    else
+    {
+        ok = writeEdgeList(output, n, edges, src, dst);
+    }
+    free(src);
+    free(dst);
+    if (!ok)
+    {
+        return 1;
+    }
+    printf("Wrote %s in %f s\n", output, omp_get_wtime() - start_time);
+    return 0;
+}
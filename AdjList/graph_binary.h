@@ -0,0 +1,31 @@
+#ifndef GRAPH_BINARY_H
+#define GRAPH_BINARY_H
+
+#include <stdint.h>
+
+// Binary CSR graph file written by convert_graph and mapped by the PageRank
+// programs. After the header come, as native-endian int32 arrays:
+//   inOffsets[n + 1]  in-links of v are inSources[inOffsets[v] .. inOffsets[v + 1])
+//   inSources[edges]  source vertex of each in-link
+//   outLinks[n]       out-degree of each vertex
+#define GRAPH_BINARY_MAGIC "PRCSR\0\0"
+#define GRAPH_BINARY_VERSION 1
+
+// Set when the in-links of every vertex are sorted by source.
+#define GRAPH_BINARY_SORTED 0x1u
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int64_t n;
+    int64_t edges;
+} GraphBinaryHeader;
+
+static inline size_t graphBinarySize(int64_t n, int64_t edges)
+{
+    return sizeof(GraphBinaryHeader) + (size_t)(2 * n + 1 + edges) * sizeof(int32_t);
+}
+
+#endif
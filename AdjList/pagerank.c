@@ -0,0 +1,4031 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "graph_binary.h"
+#include "pagerank.h"
+
+#if RANK_PRECISION == PRECISION_DOUBLE
+typedef double rank_t;
+typedef double accum_t;
+#elif RANK_PRECISION == PRECISION_MIXED
+typedef float rank_t;
+typedef double accum_t;
+#elif RANK_PRECISION == PRECISION_FLOAT
+typedef float rank_t;
+typedef float accum_t;
+#else
+#error "RANK_PRECISION must be PRECISION_DOUBLE, PRECISION_MIXED or PRECISION_FLOAT"
+#endif
+
+// The push engine switches from its frontier list to scanning every vertex
+// once more than n / PUSH_DENSE_DIVISOR vertices are active.
+#define PUSH_DENSE_DIVISOR 16
+
+// Blocks handed out by the dynamic and guided schedules, per thread.
+#define BLOCKS_PER_THREAD 16
+
+// The blocked engine gathers from one segment of source vertices at a time,
+// sized so that its contributions take at most half the L2 cache, or
+// SEGMENT_DEFAULT_BYTES if the cache size is unknown.
+#define SEGMENT_DEFAULT_BYTES (1 << 20)
+
+// Segments are made larger if needed to keep at most this many, since the
+// engine indexes every pair of segments.
+#define SEGMENT_MAX_COUNT 1024
+
+// Vertices with fewer in-links than this are summed by the inline scalar loop.
+#define SIMD_MIN_DEGREE 16
+
+// Gorder places each vertex next to the one that shares the most neighbours
+// with the last GORDER_WINDOW placed vertices.
+#define GORDER_WINDOW 5
+
+// Timers of the solve being profiled, in activeProfile. PROFILE_START(t)
+// declares a timestamp, PROFILE_PHASE charges the time since it (and the
+// counted events since the last phase) to a phase and restarts it, and
+// PROFILE_BUSY charges it to the calling thread's busy time.
+// Without PAGERANK_PROFILE they expand to nothing.
+#if PAGERANK_PROFILE
+static Profile *activeProfile;
+static void chargePhase(Phase phase, double *t);
+#define PROFILE_START(t) double t = activeProfile ? omp_get_wtime() : 0.0
+#define PROFILE_RESTART(t) ((t) = activeProfile ? omp_get_wtime() : 0.0)
+#define PROFILE_PHASE(phase, t)                                  \
+    do                                                           \
+    {                                                            \
+        if (activeProfile)                                       \
+        {                                                        \
+            chargePhase(phase, &(t));                            \
+        }                                                        \
+    } while (0)
+#define PROFILE_BUSY(t)                                                              \
+    do                                                                               \
+    {                                                                                \
+        if (activeProfile)                                                           \
+        {                                                                            \
+            activeProfile->busy[omp_get_thread_num()] += omp_get_wtime() - (t);      \
+        }                                                                            \
+    } while (0)
+#define PROFILE_TRACE(l1, max)                                                       \
+    do                                                                               \
+    {                                                                                \
+        if (activeProfile)                                                           \
+        {                                                                            \
+            activeProfile->residualL1[activeProfile->traceLength] = (l1);            \
+            activeProfile->residualMax[activeProfile->traceLength++] = (max);        \
+        }                                                                            \
+    } while (0)
+#else
+#define PROFILE_START(t)
+#define PROFILE_RESTART(t)
+#define PROFILE_PHASE(phase, t)
+#define PROFILE_BUSY(t)
+#define PROFILE_TRACE(l1, max)
+#endif
+
+// A block is either the vertex range [begin, end), or, when heavy >= 0, the
+// slice [begin, end) of the in-links of the heavy vertex partition.heavy[heavy].
+typedef struct
+{
+    int begin;
+    int end;
+    int heavy;
+} Block;
+
+// The blocks of heavy vertex h are blocks[heavyFirst[h] .. heavyEnd[h]).
+typedef struct
+{
+    int count;
+    Block *blocks;
+    int heavyCount;
+    int *heavy;
+    int *heavyFirst;
+    int *heavyEnd;
+} Partition;
+
+static Graph *createGraph(int n, int edges)
+{
+    Graph *g = (Graph *)malloc(sizeof(Graph));
+    g->n = n;
+    g->edges = edges;
+    g->outLinks = (int *)calloc(n, sizeof(int));
+    g->inOffsets = (int *)calloc(n + 1, sizeof(int));
+    g->inSources = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+    g->outOffsets = NULL;
+    g->outTargets = NULL;
+    g->originalIds = NULL;
+    g->mapping = NULL;
+    g->mappingSize = 0;
+    return g;
+}
+
+static int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Turns per-vertex counts in a[1 .. n] into offsets in a[0 .. n], with a[0] = 0.
+static void prefixSum(int *a, int n)
+{
+    int chunks = omp_get_max_threads();
+    int *partial = (int *)calloc(chunks + 1, sizeof(int));
+    a[0] = 0;
+
+    #pragma omp parallel num_threads(chunks)
+    {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        int begin = 1 + (int)((long long)n * t / nt);
+        int end = 1 + (int)((long long)n * (t + 1) / nt);
+        int sum = 0;
+        for (int i = begin; i < end; i++)
+        {
+            sum += a[i];
+            a[i] = sum;
+        }
+        partial[t + 1] = sum;
+
+        #pragma omp barrier
+        #pragma omp single
+        for (int i = 0; i < nt; i++)
+        {
+            partial[i + 1] += partial[i];
+        }
+
+        for (int i = begin; i < end; i++)
+        {
+            a[i] += partial[t];
+        }
+    }
+    free(partial);
+}
+
+// Builds the in-link columns from an edge list with a parallel counting sort.
+// Columns are sorted by source so the result does not depend on the thread count.
+Graph *buildGraph(int n, int edges, const int *src, const int *dst)
+{
+    int i, v;
+    int invalid = n <= 0 || edges < 0;
+
+    #pragma omp parallel for shared(src, dst, n) private(i) reduction(|| : invalid)
+    for (i = 0; i < edges; i++)
+    {
+        if (src[i] < 0 || dst[i] < 0 || src[i] >= n || dst[i] >= n)
+        {
+            invalid = 1;
+        }
+    }
+    if (invalid)
+    {
+        printf("Error: Invalid edge or out-of-bounds node.\n");
+        return NULL;
+    }
+    Graph *g = createGraph(n, edges);
+
+    #pragma omp parallel for shared(g, src, dst) private(i)
+    for (i = 0; i < edges; i++)
+    {
+        #pragma omp atomic
+        g->outLinks[src[i]]++;
+        #pragma omp atomic
+        g->inOffsets[dst[i] + 1]++;
+    }
+    prefixSum(g->inOffsets, n);
+
+    int *next = (int *)malloc(n * sizeof(int));
+    #pragma omp parallel for shared(g, next) private(v)
+    for (v = 0; v < n; v++)
+    {
+        next[v] = g->inOffsets[v];
+    }
+
+    #pragma omp parallel for shared(g, src, dst, next) private(i)
+    for (i = 0; i < edges; i++)
+    {
+        int slot;
+        #pragma omp atomic capture
+        slot = next[dst[i]]++;
+        g->inSources[slot] = src[i];
+    }
+    free(next);
+
+    #pragma omp parallel for shared(g) private(v) schedule(dynamic, 1024)
+    for (v = 0; v < n; v++)
+    {
+        qsort(g->inSources + g->inOffsets[v], g->inOffsets[v + 1] - g->inOffsets[v],
+              sizeof(int), compareInts);
+    }
+    return g;
+}
+
+// Reads a decimal integer at *p after skipping spaces and tabs, leaving *p
+// just past it. Returns 0 when there is no integer or it overflows an int.
+static int scanInt(const char **p, const char *end, int *value)
+{
+    const char *c = *p;
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+    {
+        c++;
+    }
+
+    int negative = 0;
+    if (c < end && *c == '-')
+    {
+        negative = 1;
+        c++;
+    }
+    if (c == end || *c < '0' || *c > '9')
+    {
+        return 0;
+    }
+
+    long long x = 0;
+    while (c < end && *c >= '0' && *c <= '9')
+    {
+        x = x * 10 + (*c - '0');
+        if (x > 2147483647LL)
+        {
+            return 0;
+        }
+        c++;
+    }
+    *value = negative ? (int)-x : (int)x;
+    *p = c;
+    return 1;
+}
+
+// Parses one "u v" line starting at *p and moves *p to the start of the next
+// line. Returns 1 for an edge, 0 for a blank line and -1 for a malformed line.
+static int scanEdgeLine(const char **p, const char *end, int *u, int *v)
+{
+    const char *c = *p;
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+    {
+        c++;
+    }
+
+    int result = 0;
+    if (c < end && *c != '\n')
+    {
+        result = scanInt(&c, end, u) && scanInt(&c, end, v) ? 1 : -1;
+        while (result == 1 && c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+        {
+            c++;
+        }
+        if (result == 1 && c < end && *c != '\n')
+        {
+            result = -1;
+        }
+    }
+
+    const char *nl = c < end ? memchr(c, '\n', end - c) : NULL;
+    *p = nl ? nl + 1 : end;
+    return result;
+}
+
+// Maps the text edge list and parses it in parallel: the body is split into
+// chunks on line boundaries, each chunk counts its edges, and a prefix sum
+// over the counts tells each chunk where to write its parsed edges.
+Graph *readGraphFromFile(const char *filename)
+{
+    int n, edges;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        printf("Error: Invalid file format.\n");
+        close(fd);
+        return NULL;
+    }
+
+    char *text = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED)
+    {
+        printf("Error: Could not map file %s\n", filename);
+        return NULL;
+    }
+    const char *end = text + st.st_size;
+
+    const char *body = text;
+    while (body < end && (*body == ' ' || *body == '\t' || *body == '\r' || *body == '\n'))
+    {
+        body++;
+    }
+    if (!scanInt(&body, end, &n) || !scanInt(&body, end, &edges) || n <= 0 || edges < 0)
+    {
+        printf("Error: Invalid file format.\n");
+        munmap(text, st.st_size);
+        return NULL;
+    }
+
+    int chunks = 4 * omp_get_max_threads();
+    const char **bounds = (const char **)malloc((chunks + 1) * sizeof(char *));
+    long long *counts = (long long *)calloc(chunks + 1, sizeof(long long));
+    size_t length = end - body;
+    bounds[0] = body;
+    bounds[chunks] = end;
+    for (int k = 1; k < chunks; k++)
+    {
+        const char *c = body + length / chunks * k;
+        if (c < bounds[k - 1])
+        {
+            c = bounds[k - 1];
+        }
+        while (c < end && c > body && c[-1] != '\n')
+        {
+            c++;
+        }
+        bounds[k] = c;
+    }
+
+    // A chunk stops counting at its first malformed line, which only matters
+    // when it comes before the last edge the header asks for.
+    char *broken = (char *)calloc(chunks, sizeof(char));
+    int malformed = 0;
+    int k;
+    #pragma omp parallel for shared(bounds, counts, broken) private(k) schedule(dynamic, 1)
+    for (k = 0; k < chunks; k++)
+    {
+        const char *c = bounds[k];
+        int u, v, status;
+        long long count = 0;
+        while (c < bounds[k + 1])
+        {
+            status = scanEdgeLine(&c, bounds[k + 1], &u, &v);
+            if (status < 0)
+            {
+                broken[k] = 1;
+                break;
+            }
+            count += status;
+        }
+        counts[k + 1] = count;
+    }
+    for (k = 0; k < chunks; k++)
+    {
+        counts[k + 1] += counts[k];
+        if (broken[k] && counts[k + 1] < edges)
+        {
+            malformed = 1;
+        }
+    }
+    free(broken);
+
+    int *src = NULL, *dst = NULL;
+    int invalid = malformed || counts[chunks] < edges;
+    if (!invalid)
+    {
+        src = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+        dst = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+
+        // Edges past the count given in the header are ignored, as before.
+        #pragma omp parallel for shared(bounds, counts, src, dst, invalid) private(k) schedule(dynamic, 1)
+        for (k = 0; k < chunks; k++)
+        {
+            const char *c = bounds[k];
+            long long i = counts[k];
+            int u, v;
+            while (c < bounds[k + 1] && i < edges)
+            {
+                if (scanEdgeLine(&c, bounds[k + 1], &u, &v) == 0)
+                {
+                    continue;
+                }
+                if (u < 0 || v < 0 || u >= n || v >= n)
+                {
+                    #pragma omp atomic write
+                    invalid = 1;
+                    break;
+                }
+                src[i] = u;
+                dst[i] = v;
+                i++;
+            }
+        }
+    }
+
+    free(bounds);
+    free(counts);
+    munmap(text, st.st_size);
+    if (invalid)
+    {
+        printf("Error: Invalid edge or out-of-bounds node.\n");
+        free(src);
+        free(dst);
+        return NULL;
+    }
+
+    Graph *g = buildGraph(n, edges, src, dst);
+    free(src);
+    free(dst);
+    return g;
+}
+
+// Checks the arrays the engines index with: in-link offsets that never
+// decrease, sources in [0, n) and out-degrees that count those sources.
+// Returns 1 when g is consistent.
+static int validateGraph(const Graph *g)
+{
+    int v, e, invalid = 0;
+    int *counts = (int *)calloc(g->n, sizeof(int));
+
+    #pragma omp parallel shared(g, counts, invalid) private(v, e)
+    {
+        #pragma omp for reduction(+ : invalid)
+        for (v = 0; v < g->n; v++)
+        {
+            if (g->inOffsets[v] > g->inOffsets[v + 1])
+            {
+                invalid++;
+            }
+        }
+        #pragma omp for reduction(+ : invalid)
+        for (e = 0; e < g->edges; e++)
+        {
+            int u = g->inSources[e];
+            if (u < 0 || u >= g->n)
+            {
+                invalid++;
+                continue;
+            }
+            #pragma omp atomic
+            counts[u]++;
+        }
+        #pragma omp for reduction(+ : invalid)
+        for (v = 0; v < g->n; v++)
+        {
+            if (counts[v] != g->outLinks[v])
+            {
+                invalid++;
+            }
+        }
+    }
+
+    free(counts);
+    return invalid == 0;
+}
+
+// Maps a file written by convert_graph. The arrays are used in place, after
+// validateGraph has checked them.
+Graph *readGraphFromBinaryFile(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GraphBinaryHeader))
+    {
+        printf("Error: Invalid file format.\n");
+        close(fd);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        printf("Error: Could not map file %s\n", filename);
+        return NULL;
+    }
+
+    const GraphBinaryHeader *header = (const GraphBinaryHeader *)mapping;
+    int32_t *data = (int32_t *)((char *)mapping + sizeof(GraphBinaryHeader));
+    if (memcmp(header->magic, GRAPH_BINARY_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GRAPH_BINARY_VERSION ||
+        header->n <= 0 || header->n > INT32_MAX ||
+        header->edges < 0 || header->edges > INT32_MAX ||
+        (size_t)st.st_size != graphBinarySize(header->n, header->edges) ||
+        data[0] != 0 || data[header->n] != header->edges)
+    {
+        printf("Error: Invalid file format.\n");
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+
+    Graph *g = (Graph *)malloc(sizeof(Graph));
+    g->n = (int)header->n;
+    g->edges = (int)header->edges;
+    g->inOffsets = data;
+    g->inSources = data + g->n + 1;
+    g->outLinks = data + g->n + 1 + g->edges;
+    g->outOffsets = NULL;
+    g->outTargets = NULL;
+    g->originalIds = NULL;
+    g->mapping = mapping;
+    g->mappingSize = st.st_size;
+    if (!validateGraph(g))
+    {
+        printf("Error: Invalid edge or out-of-bounds node.\n");
+        freeGraph(g);
+        return NULL;
+    }
+    return g;
+}
+
+// Writes g, in its own vertex order, as a binary CSR file for
+// readGraphFromBinaryFile. Returns 1 on success.
+int writeGraphBinary(Graph *g, const char *filename)
+{
+    GraphBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GRAPH_BINARY_MAGIC, sizeof(header.magic));
+    header.version = GRAPH_BINARY_VERSION;
+    header.flags = GRAPH_BINARY_SORTED;
+    header.n = g->n;
+    header.edges = g->edges;
+
+    FILE *fout = fopen(filename, "wb");
+    if (!fout)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fout) == 1 &&
+             fwrite(g->inOffsets, sizeof(int), g->n + 1, fout) == (size_t)g->n + 1 &&
+             fwrite(g->inSources, sizeof(int), g->edges, fout) == (size_t)g->edges &&
+             fwrite(g->outLinks, sizeof(int), g->n, fout) == (size_t)g->n;
+    if (fclose(fout) != 0)
+    {
+        ok = 0;
+    }
+    if (!ok)
+    {
+        printf("Error: Could not write file %s\n", filename);
+    }
+    return ok;
+}
+
+int isBinaryGraphFile(const char *filename)
+{
+    char magic[8];
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        return 0;
+    }
+    int matches = fread(magic, sizeof(magic), 1, file) == 1 &&
+                  memcmp(magic, GRAPH_BINARY_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return matches;
+}
+
+// Loads either format; text edge lists remain the import path.
+Graph *readGraph(const char *filename)
+{
+    if (isBinaryGraphFile(filename))
+    {
+        return readGraphFromBinaryFile(filename);
+    }
+    return readGraphFromFile(filename);
+}
+
+// Builds the out-link rows from the in-link columns.
+static void buildOutEdges(Graph *g)
+{
+    if (g->outOffsets)
+    {
+        return;
+    }
+    int u, v;
+    g->outOffsets = (int *)malloc((g->n + 1) * sizeof(int));
+    g->outTargets = (int *)malloc((g->edges > 0 ? g->edges : 1) * sizeof(int));
+    for (u = 0; u < g->n; u++)
+    {
+        g->outOffsets[u + 1] = g->outLinks[u];
+    }
+    prefixSum(g->outOffsets, g->n);
+
+    // Rows are filled by several threads in any order; the push engine's
+    // atomic updates do not depend on it.
+    int *next = (int *)malloc(g->n * sizeof(int));
+    memcpy(next, g->outOffsets, g->n * sizeof(int));
+    #pragma omp parallel for shared(g, next) private(v)
+    for (v = 0; v < g->n; v++)
+    {
+        for (int e = g->inOffsets[v]; e < g->inOffsets[v + 1]; e++)
+        {
+            int slot;
+            #pragma omp atomic capture
+            slot = next[g->inSources[e]]++;
+            g->outTargets[slot] = v;
+        }
+    }
+    free(next);
+}
+
+void freeGraph(Graph *g)
+{
+    free(g->outOffsets);
+    free(g->outTargets);
+    free(g->originalIds);
+    if (g->mapping)
+    {
+        munmap(g->mapping, g->mappingSize);
+    }
+    else
+    {
+        free(g->inSources);
+        free(g->inOffsets);
+        free(g->outLinks);
+    }
+    free(g);
+}
+
+static int compareLongLongs(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Degree sort: vertices by decreasing out-degree, i.e. by how often their
+// rank is gathered, so the most-read ranks share cache lines. A stable
+// counting sort, so ties keep their input order. Returns the vertices in
+// their new order.
+static int *degreeOrder(Graph *g)
+{
+    int n = g->n, maxDegree = 0, v;
+    #pragma omp parallel for shared(g) private(v) reduction(max : maxDegree)
+    for (v = 0; v < n; v++)
+    {
+        if (g->outLinks[v] > maxDegree)
+        {
+            maxDegree = g->outLinks[v];
+        }
+    }
+
+    int *start = (int *)calloc(maxDegree + 2, sizeof(int));
+    int *order = (int *)malloc(n * sizeof(int));
+    for (v = 0; v < n; v++)
+    {
+        start[maxDegree - g->outLinks[v] + 1]++;
+    }
+    for (int d = 0; d <= maxDegree; d++)
+    {
+        start[d + 1] += start[d];
+    }
+    for (v = 0; v < n; v++)
+    {
+        order[start[maxDegree - g->outLinks[v]]++] = v;
+    }
+    free(start);
+    return order;
+}
+
+// Reverse Cuthill-McKee on the graph with directions ignored: a breadth-first
+// search from a lowest-degree unvisited vertex of each component, visiting
+// the neighbours of each vertex by increasing degree, read backwards. Linked
+// vertices end up with nearby labels.
+static int *rcmOrder(Graph *g)
+{
+    int n = g->n, maxDegree = 0, v;
+    buildOutEdges(g);
+    int *degree = (int *)malloc(n * sizeof(int));
+    #pragma omp parallel for shared(g, degree) private(v) reduction(max : maxDegree)
+    for (v = 0; v < n; v++)
+    {
+        degree[v] = g->outLinks[v] + g->inOffsets[v + 1] - g->inOffsets[v];
+        if (degree[v] > maxDegree)
+        {
+            maxDegree = degree[v];
+        }
+    }
+
+    // Component roots are tried by increasing degree.
+    int *start = (int *)calloc(maxDegree + 2, sizeof(int));
+    int *roots = (int *)malloc(n * sizeof(int));
+    for (v = 0; v < n; v++)
+    {
+        start[degree[v] + 1]++;
+    }
+    for (int d = 0; d <= maxDegree; d++)
+    {
+        start[d + 1] += start[d];
+    }
+    for (v = 0; v < n; v++)
+    {
+        roots[start[degree[v]]++] = v;
+    }
+    free(start);
+
+    int *order = (int *)malloc(n * sizeof(int));
+    char *visited = (char *)calloc(n, 1);
+    long long *neighbours = (long long *)malloc((maxDegree > 0 ? maxDegree : 1) * sizeof(long long));
+    int head = 0, tail = 0;
+    for (int r = 0; r < n; r++)
+    {
+        if (visited[roots[r]])
+        {
+            continue;
+        }
+        visited[roots[r]] = 1;
+        order[tail++] = roots[r];
+        while (head < tail)
+        {
+            v = order[head++];
+            int count = 0;
+            for (int e = g->inOffsets[v]; e < g->inOffsets[v + 1]; e++)
+            {
+                int u = g->inSources[e];
+                if (!visited[u])
+                {
+                    visited[u] = 1;
+                    neighbours[count++] = (long long)degree[u] << 32 | u;
+                }
+            }
+            for (int e = g->outOffsets[v]; e < g->outOffsets[v + 1]; e++)
+            {
+                int w = g->outTargets[e];
+                if (!visited[w])
+                {
+                    visited[w] = 1;
+                    neighbours[count++] = (long long)degree[w] << 32 | w;
+                }
+            }
+            qsort(neighbours, count, sizeof(long long), compareLongLongs);
+            for (int i = 0; i < count; i++)
+            {
+                order[tail++] = (int)(neighbours[i] & 0xffffffff);
+            }
+        }
+    }
+
+    for (int i = 0; i < n / 2; i++)
+    {
+        int t = order[i];
+        order[i] = order[n - 1 - i];
+        order[n - 1 - i] = t;
+    }
+    free(degree);
+    free(roots);
+    free(visited);
+    free(neighbours);
+    return order;
+}
+
+// Unplaced vertices bucketed by Gorder score. Scores only change by one, so
+// the top bucket is found by walking down from the previous one.
+typedef struct
+{
+    int *score;
+    int *prev;
+    int *next;
+    int *head;
+    char *placed;
+    int capacity;
+    int top;
+} UnitHeap;
+
+static void unitHeapUnlink(UnitHeap *heap, int v)
+{
+    if (heap->prev[v] >= 0)
+    {
+        heap->next[heap->prev[v]] = heap->next[v];
+    }
+    else
+    {
+        heap->head[heap->score[v]] = heap->next[v];
+    }
+    if (heap->next[v] >= 0)
+    {
+        heap->prev[heap->next[v]] = heap->prev[v];
+    }
+}
+
+static void unitHeapLink(UnitHeap *heap, int v)
+{
+    int s = heap->score[v];
+    if (s >= heap->capacity)
+    {
+        int capacity = heap->capacity * 2;
+        heap->head = (int *)realloc(heap->head, capacity * sizeof(int));
+        for (int i = heap->capacity; i < capacity; i++)
+        {
+            heap->head[i] = -1;
+        }
+        heap->capacity = capacity;
+    }
+    heap->prev[v] = -1;
+    heap->next[v] = heap->head[s];
+    if (heap->head[s] >= 0)
+    {
+        heap->prev[heap->head[s]] = v;
+    }
+    heap->head[s] = v;
+    if (s > heap->top)
+    {
+        heap->top = s;
+    }
+}
+
+static void unitHeapAdd(UnitHeap *heap, int v, int delta)
+{
+    if (heap->placed[v])
+    {
+        return;
+    }
+    unitHeapUnlink(heap, v);
+    heap->score[v] += delta;
+    unitHeapLink(heap, v);
+}
+
+static void unitHeapPlace(UnitHeap *heap, int v)
+{
+    unitHeapUnlink(heap, v);
+    heap->placed[v] = 1;
+}
+
+static int unitHeapPop(UnitHeap *heap)
+{
+    while (heap->top > 0 && heap->head[heap->top] < 0)
+    {
+        heap->top--;
+    }
+    int v = heap->head[heap->top];
+    unitHeapPlace(heap, v);
+    return v;
+}
+
+// Adds delta to the score of every unplaced vertex linked to v or sharing an
+// in-neighbour with it. In-neighbours with more than hub out-links are
+// skipped as sibling sources; they relate nearly everything to everything.
+static void gorderScore(Graph *g, UnitHeap *heap, int v, int delta, int hub)
+{
+    for (int e = g->outOffsets[v]; e < g->outOffsets[v + 1]; e++)
+    {
+        unitHeapAdd(heap, g->outTargets[e], delta);
+    }
+    for (int e = g->inOffsets[v]; e < g->inOffsets[v + 1]; e++)
+    {
+        int u = g->inSources[e];
+        unitHeapAdd(heap, u, delta);
+        if (g->outLinks[u] <= hub)
+        {
+            for (int f = g->outOffsets[u]; f < g->outOffsets[u + 1]; f++)
+            {
+                unitHeapAdd(heap, g->outTargets[f], delta);
+            }
+        }
+    }
+}
+
+// Greedy Gorder (Wei et al.): starting from the vertex with the most
+// in-links, repeatedly place the vertex with the most links and shared
+// in-neighbours to the last GORDER_WINDOW placed ones.
+static int *gorderOrder(Graph *g)
+{
+    int n = g->n, first = 0, v;
+    int hub = (int)sqrt((double)n);
+    buildOutEdges(g);
+
+    UnitHeap heap;
+    heap.score = (int *)calloc(n, sizeof(int));
+    heap.prev = (int *)malloc(n * sizeof(int));
+    heap.next = (int *)malloc(n * sizeof(int));
+    heap.placed = (char *)calloc(n, 1);
+    heap.capacity = 64;
+    heap.head = (int *)malloc(heap.capacity * sizeof(int));
+    heap.top = 0;
+    for (int i = 0; i < heap.capacity; i++)
+    {
+        heap.head[i] = -1;
+    }
+    for (v = n - 1; v >= 0; v--)
+    {
+        unitHeapLink(&heap, v);
+        if (g->inOffsets[v + 1] - g->inOffsets[v] >= g->inOffsets[first + 1] - g->inOffsets[first])
+        {
+            first = v;
+        }
+    }
+
+    int *order = (int *)malloc(n * sizeof(int));
+    unitHeapPlace(&heap, first);
+    order[0] = first;
+    gorderScore(g, &heap, first, 1, hub);
+    for (int i = 1; i < n; i++)
+    {
+        if (i > GORDER_WINDOW)
+        {
+            gorderScore(g, &heap, order[i - GORDER_WINDOW - 1], -1, hub);
+        }
+        order[i] = unitHeapPop(&heap);
+        gorderScore(g, &heap, order[i], 1, hub);
+    }
+
+    free(heap.score);
+    free(heap.prev);
+    free(heap.next);
+    free(heap.placed);
+    free(heap.head);
+    return order;
+}
+
+// Returns a copy of g with its vertices relabelled by ordering; vertex i of
+// the copy is vertex order[i] of g. Columns stay sorted by source.
+Graph *reorderGraph(Graph *g, Ordering ordering)
+{
+    int n = g->n, i, v;
+    int *order = ordering == ORDER_DEGREE ? degreeOrder(g) :
+                 ordering == ORDER_RCM    ? rcmOrder(g) : gorderOrder(g);
+    int *newIds = (int *)malloc(n * sizeof(int));
+    Graph *h = createGraph(n, g->edges);
+
+    #pragma omp parallel for shared(g, h, order, newIds) private(i, v)
+    for (i = 0; i < n; i++)
+    {
+        v = order[i];
+        newIds[v] = i;
+        h->outLinks[i] = g->outLinks[v];
+        h->inOffsets[i + 1] = g->inOffsets[v + 1] - g->inOffsets[v];
+    }
+    prefixSum(h->inOffsets, n);
+
+    #pragma omp parallel for shared(g, h, order, newIds) private(i) schedule(dynamic, 1024)
+    for (i = 0; i < n; i++)
+    {
+        int *column = h->inSources + h->inOffsets[i];
+        int begin = g->inOffsets[order[i]], count = g->inOffsets[order[i] + 1] - begin;
+        for (int e = 0; e < count; e++)
+        {
+            column[e] = newIds[g->inSources[begin + e]];
+        }
+        qsort(column, count, sizeof(int), compareInts);
+    }
+
+    // Relabelling an already relabelled graph composes the two maps.
+    if (g->originalIds)
+    {
+        #pragma omp parallel for shared(g, order) private(i)
+        for (i = 0; i < n; i++)
+        {
+            order[i] = g->originalIds[order[i]];
+        }
+    }
+    h->originalIds = order;
+    free(newIds);
+    return h;
+}
+
+// Rank vertex p gets whatever its in-links: its teleport share of 1 - d and
+// of the dangling rank, whose uniform share dp is damping * dangling / n.
+// Without a teleport vector every vertex's share is 1 / n.
+static inline double teleportShare(const double *teleport, int n, int p, double dp, double damping)
+{
+    return teleport ? (1.0 - damping + dp * n) * teleport[p] : dp + (1.0 - damping) / n;
+}
+
+static void initializePageRank(Graph *g, double *opg)
+{
+    int i;
+    // Parallelize initialization since each node's PageRank value is independent.
+    #pragma omp parallel for shared(opg,g) private(i)
+    for (i = 0; i < g->n; i++)
+    {
+        opg[i] = 1.0 / g->n;
+    }
+}
+
+static double computeDanglingContribution(Graph *g, double *opg, double damping)
+{
+    double dp = 0.0;
+    int p;
+    //  Parallelize sum computation across nodes with reduction to avoid race conditions.
+    #pragma omp parallel for shared(g, opg, damping) reduction(+ : dp) private(p)
+    for (p = 0; p < g->n; p++)
+    {
+        if (g->outLinks[p] == 0)
+        {
+            dp += (damping * opg[p]) / g->n;
+        }
+    }
+    return dp;
+}
+
+static void updatePageRank(Graph *g, double *opg, double *npg, double dp, double damping, const double *teleport)
+{
+    // Parallelizing this ensures each node computes its new rank independently.
+    int ip, p, e;
+    double sum;
+    #pragma omp parallel shared(g, opg, npg, dp, damping, teleport) private(p, e, ip, sum)
+    {
+        PROFILE_START(start);
+        #pragma omp for nowait
+        for (p = 0; p < g->n; p++)
+        {
+            sum = teleportShare(teleport, g->n, p, dp, damping);
+            for (e = g->inOffsets[p]; e < g->inOffsets[p + 1]; e++)
+            {
+                ip = g->inSources[e];
+                sum += (damping * opg[ip]) / g->outLinks[ip];
+            }
+            npg[p] = sum;
+        }
+        PROFILE_BUSY(start);
+    }
+}
+
+// Scales each out-link by damping / outdegree once per solve, so the pull
+// kernel multiplies instead of dividing. Dangling vertices get 0.
+static void computeInverseOutLinks(Graph *g, double *invOutLinks, double damping)
+{
+    int p;
+    #pragma omp parallel for shared(g, invOutLinks, damping) private(p)
+    for (p = 0; p < g->n; p++)
+    {
+        invOutLinks[p] = g->outLinks[p] ? damping / g->outLinks[p] : 0.0;
+    }
+}
+
+// One pass over the vertices computes contrib[p] = d * opg[p] / outdegree(p)
+// and, in the same loop, the dangling contribution that is returned.
+static double computeContributions(Graph *g, double *invOutLinks, double *opg, rank_t *contrib, double damping)
+{
+    double dangling = 0.0;
+    int p;
+    #pragma omp parallel for shared(g, invOutLinks, opg, contrib) reduction(+ : dangling) private(p)
+    for (p = 0; p < g->n; p++)
+    {
+        contrib[p] = (rank_t)(opg[p] * invOutLinks[p]);
+        if (g->outLinks[p] == 0)
+        {
+            dangling += opg[p];
+        }
+    }
+    return damping * dangling / g->n;
+}
+
+static void addBlock(Partition *part, int *capacity, int begin, int end, int heavy)
+{
+    if (part->count == *capacity)
+    {
+        *capacity *= 2;
+        part->blocks = (Block *)realloc(part->blocks, *capacity * sizeof(Block));
+    }
+    part->blocks[part->count].begin = begin;
+    part->blocks[part->count].end = end;
+    part->blocks[part->count].heavy = heavy;
+    part->count++;
+}
+
+// Splits the vertices into blocks for the chosen schedule. The vertices
+// schedule uses one equal-sized vertex range per thread. The others balance
+// in-links plus one per vertex (the prefix sum is inOffsets[v] + v), with one
+// block per thread for edges and BLOCKS_PER_THREAD for dynamic and guided.
+// With splitHeavy, a vertex with more in-links than a block's share is cut
+// into edge slices whose partial sums are added up after the gather.
+static Partition *buildPartition(Graph *g, Schedule schedule, int splitHeavy, int threads)
+{
+    Partition *part = (Partition *)malloc(sizeof(Partition));
+    int capacity = 64;
+    part->count = 0;
+    part->blocks = (Block *)malloc(capacity * sizeof(Block));
+    part->heavyCount = 0;
+    part->heavy = NULL;
+    part->heavyFirst = NULL;
+    part->heavyEnd = NULL;
+
+    int target = schedule == SCHEDULE_DYNAMIC || schedule == SCHEDULE_GUIDED ? threads * BLOCKS_PER_THREAD : threads;
+    if (schedule == SCHEDULE_VERTICES)
+    {
+        for (int t = 0; t < target; t++)
+        {
+            addBlock(part, &capacity, (int)((long long)g->n * t / target),
+                     (int)((long long)g->n * (t + 1) / target), -1);
+        }
+        return part;
+    }
+
+    double share = ((double)g->edges + g->n) / target;
+    int heavyCapacity = 0;
+    int begin = 0;
+    double work = 0.0;
+    for (int v = 0; v < g->n; v++)
+    {
+        int degree = g->inOffsets[v + 1] - g->inOffsets[v];
+        if (splitHeavy && degree > share)
+        {
+            if (begin < v)
+            {
+                addBlock(part, &capacity, begin, v, -1);
+            }
+            if (part->heavyCount == heavyCapacity)
+            {
+                heavyCapacity = heavyCapacity ? 2 * heavyCapacity : 16;
+                part->heavy = (int *)realloc(part->heavy, heavyCapacity * sizeof(int));
+                part->heavyFirst = (int *)realloc(part->heavyFirst, heavyCapacity * sizeof(int));
+                part->heavyEnd = (int *)realloc(part->heavyEnd, heavyCapacity * sizeof(int));
+            }
+            part->heavy[part->heavyCount] = v;
+            part->heavyFirst[part->heavyCount] = part->count;
+            int pieces = (int)ceil(degree / share);
+            for (int k = 0; k < pieces; k++)
+            {
+                addBlock(part, &capacity, g->inOffsets[v] + (int)((long long)degree * k / pieces),
+                         g->inOffsets[v] + (int)((long long)degree * (k + 1) / pieces), part->heavyCount);
+            }
+            part->heavyEnd[part->heavyCount] = part->count;
+            part->heavyCount++;
+            begin = v + 1;
+            work = 0.0;
+            continue;
+        }
+
+        work += degree + 1;
+        if (work >= share)
+        {
+            addBlock(part, &capacity, begin, v + 1, -1);
+            begin = v + 1;
+            work = 0.0;
+        }
+    }
+    if (begin < g->n)
+    {
+        addBlock(part, &capacity, begin, g->n, -1);
+    }
+    return part;
+}
+
+static void freePartition(Partition *part)
+{
+    free(part->blocks);
+    free(part->heavy);
+    free(part->heavyFirst);
+    free(part->heavyEnd);
+    free(part);
+}
+
+// Picks the OpenMP schedule used by the schedule(runtime) loops over blocks.
+static void applySchedule(Schedule schedule)
+{
+    if (schedule == SCHEDULE_DYNAMIC)
+    {
+        omp_set_schedule(omp_sched_dynamic, 1);
+    }
+    else if (schedule == SCHEDULE_GUIDED)
+    {
+        omp_set_schedule(omp_sched_guided, 1);
+    }
+    else
+    {
+        omp_set_schedule(omp_sched_static, 1);
+    }
+}
+
+// Writes zeros over array one partition block at a time, with the schedule
+// the update loops use, so that first touch places each page on the socket
+// of the thread that will update it.
+static void firstTouch(Partition *part, void *array, size_t elementSize)
+{
+    int b;
+    #pragma omp parallel for schedule(runtime) shared(part, array, elementSize) private(b)
+    for (b = 0; b < part->count; b++)
+    {
+        Block *block = &part->blocks[b];
+        if (block->heavy < 0)
+        {
+            memset((char *)array + block->begin * elementSize, 0, (block->end - block->begin) * elementSize);
+        }
+    }
+}
+
+// Replaces the in-link arrays of g with copies made block by block under the
+// update schedule, so each socket's threads read columns from local memory.
+static void localizeGraph(Graph *g, Partition *part)
+{
+    int *outLinks = (int *)malloc(g->n * sizeof(int));
+    int *inOffsets = (int *)malloc((g->n + 1) * sizeof(int));
+    int *inSources = (int *)malloc((g->edges > 0 ? g->edges : 1) * sizeof(int));
+    int b, h;
+
+    #pragma omp parallel shared(g, part, outLinks, inOffsets, inSources) private(b, h)
+    {
+        #pragma omp for schedule(runtime)
+        for (b = 0; b < part->count; b++)
+        {
+            Block *block = &part->blocks[b];
+            if (block->heavy >= 0)
+            {
+                memcpy(inSources + block->begin, g->inSources + block->begin, (block->end - block->begin) * sizeof(int));
+                continue;
+            }
+            int begin = g->inOffsets[block->begin], end = g->inOffsets[block->end];
+            memcpy(outLinks + block->begin, g->outLinks + block->begin, (block->end - block->begin) * sizeof(int));
+            memcpy(inOffsets + block->begin, g->inOffsets + block->begin, (block->end - block->begin) * sizeof(int));
+            memcpy(inSources + begin, g->inSources + begin, (end - begin) * sizeof(int));
+        }
+
+        #pragma omp for
+        for (h = 0; h < part->heavyCount; h++)
+        {
+            int v = part->heavy[h];
+            outLinks[v] = g->outLinks[v];
+            inOffsets[v] = g->inOffsets[v];
+        }
+    }
+    inOffsets[g->n] = g->edges;
+
+    if (g->mapping)
+    {
+        munmap(g->mapping, g->mappingSize);
+        g->mapping = NULL;
+        g->mappingSize = 0;
+    }
+    else
+    {
+        free(g->outLinks);
+        free(g->inOffsets);
+        free(g->inSources);
+    }
+    g->outLinks = outLinks;
+    g->inOffsets = inOffsets;
+    g->inSources = inSources;
+}
+
+// Parses a sysfs CPU list such as "0-3,8" into cpus; returns the count.
+static int parseCpuList(const char *list, int *cpus, int capacity)
+{
+    int count = 0;
+    while (*list)
+    {
+        char *end;
+        long first = strtol(list, &end, 10), last = first;
+        if (end == list)
+        {
+            break;
+        }
+        if (*end == '-')
+        {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && count < capacity; cpu++)
+        {
+            cpus[count++] = (int)cpu;
+        }
+        list = *end == ',' ? end + 1 : end;
+        if (*list == '\n')
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+// Reads one line of a sysfs file into buffer; returns 0 if it cannot.
+static int readSysfs(const char *path, char *buffer, int size)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return 0;
+    }
+    int read = fgets(buffer, size, file) != NULL;
+    fclose(file);
+    return read;
+}
+
+static int cpuSocket(int cpu)
+{
+    char path[128], buffer[32];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    return readSysfs(path, buffer, sizeof(buffer)) ? atoi(buffer) : 0;
+}
+
+// The CPUs this process may run on, read before any thread is pinned since
+// pinning narrows the main thread's mask, and the CPUs that solver thread t is
+// pinned to under pinPolicy: pinCpus[t % pinCount].
+static cpu_set_t allowed;
+static int allowedRead = 0;
+static Pinning pinPolicy = PIN_NONE;
+static int *pinCpus = NULL;
+static int pinCount = 0;
+
+// Orders the allowed CPUs for the pinning policy, if it changed.
+static void selectPinning(Pinning pinning)
+{
+    if (pinning == pinPolicy)
+    {
+        return;
+    }
+    free(pinCpus);
+    pinCpus = NULL;
+    pinCount = 0;
+    pinPolicy = pinning;
+    if (pinning == PIN_NONE)
+    {
+        return;
+    }
+    if (!allowedRead)
+    {
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+            return;
+        }
+        allowedRead = 1;
+    }
+
+    // Sort by (socket, cpu) as socket * CPU_SETSIZE + cpu.
+    long long *keys = (long long *)malloc(CPU_SETSIZE * sizeof(long long));
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            keys[count++] = (long long)cpuSocket(cpu) * CPU_SETSIZE + cpu;
+        }
+    }
+    qsort(keys, count, sizeof(long long), compareLongLongs);
+
+    pinCpus = (int *)malloc(count * sizeof(int));
+    if (pinning == PIN_COMPACT)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            pinCpus[i] = (int)(keys[i] % CPU_SETSIZE);
+        }
+    }
+    else
+    {
+        // Deal one CPU from each socket in turn.
+        int *next = (int *)malloc((count + 1) * sizeof(int));
+        int sockets = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (i == 0 || keys[i] / CPU_SETSIZE != keys[i - 1] / CPU_SETSIZE)
+            {
+                next[sockets++] = i;
+            }
+        }
+        next[sockets] = count;
+        int *socketEnd = (int *)malloc(sockets * sizeof(int));
+        for (int k = 0; k < sockets; k++)
+        {
+            socketEnd[k] = next[k + 1];
+        }
+        for (int placed = 0; placed < count;)
+        {
+            for (int k = 0; k < sockets; k++)
+            {
+                if (next[k] < socketEnd[k])
+                {
+                    pinCpus[placed++] = (int)(keys[next[k]++] % CPU_SETSIZE);
+                }
+            }
+        }
+        free(next);
+        free(socketEnd);
+    }
+    pinCount = count;
+    free(keys);
+}
+
+// Pins each thread of the current team size to its CPU. OpenMP reuses the
+// same threads for later regions of the same size, so this lasts the solve.
+// Without a policy, threads pinned by an earlier solve are let loose again.
+static void pinThreads(void)
+{
+    if (!allowedRead)
+    {
+        return;
+    }
+    #pragma omp parallel
+    {
+        cpu_set_t set = allowed;
+        if (pinCount > 0)
+        {
+            CPU_ZERO(&set);
+            CPU_SET(pinCpus[omp_get_thread_num() % pinCount], &set);
+        }
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+}
+
+// Turns a sysfs event description such as "event=0x04,umask=0x03" into a
+// perf config value using the PMU's format files. Returns 0 if it cannot.
+// pmu is a PMU's sysfs directory, shorter than 512 bytes as the caller
+// builds it.
+static int parsePmuEvent(const char *pmu, const char *event, unsigned long long *config)
+{
+    // Room for pmu, "/format/" and a field name.
+    char path[600], buffer[256], format[64];
+    *config = 0;
+    while (*event && *event != '\n')
+    {
+        char name[64];
+        unsigned long long value = 1;
+        int length = 0;
+        while (*event && *event != '=' && *event != ',' && *event != '\n' && length < 63)
+        {
+            name[length++] = *event++;
+        }
+        name[length] = '\0';
+        if (*event == '=')
+        {
+            char *end;
+            value = strtoull(event + 1, &end, 0);
+            event = end;
+        }
+        if (*event == ',')
+        {
+            event++;
+        }
+
+        int low, high;
+        if (snprintf(path, sizeof(path), "%s/format/%s", pmu, name) >= (int)sizeof(path) ||
+            !readSysfs(path, buffer, sizeof(buffer)) || sscanf(buffer, "%63[^:]:%d", format, &low) != 2 ||
+            strcmp(format, "config") != 0)
+        {
+            return 0;
+        }
+        if (sscanf(buffer, "%*[^:]:%d-%d", &low, &high) != 2)
+        {
+            high = low;
+        }
+        *config |= (value & ((2ULL << (high - low)) - 1)) << low;
+    }
+    return 1;
+}
+
+BandwidthCounters *openBandwidthCounters(void)
+{
+    const char *root = "/sys/bus/event_source/devices";
+    const char *events[] = {"cas_count_read", "cas_count_write"};
+    BandwidthCounters *counters = (BandwidthCounters *)calloc(1, sizeof(BandwidthCounters));
+    int capacity = 0;
+    DIR *dir = opendir(root);
+    struct dirent *entry;
+
+    while (dir && (entry = readdir(dir)) != NULL)
+    {
+        char pmu[512], path[600], buffer[256];
+        int cpus[64];
+        if (strncmp(entry->d_name, "uncore_imc", 10) != 0)
+        {
+            continue;
+        }
+        snprintf(pmu, sizeof(pmu), "%s/%s", root, entry->d_name);
+        snprintf(path, sizeof(path), "%s/type", pmu);
+        if (!readSysfs(path, buffer, sizeof(buffer)))
+        {
+            continue;
+        }
+        int type = atoi(buffer);
+        snprintf(path, sizeof(path), "%s/cpumask", pmu);
+        int cpuCount = readSysfs(path, buffer, sizeof(buffer)) ? parseCpuList(buffer, cpus, 64) : 0;
+
+        for (int k = 0; k < 2; k++)
+        {
+            unsigned long long config;
+            snprintf(path, sizeof(path), "%s/events/%s", pmu, events[k]);
+            if (!readSysfs(path, buffer, sizeof(buffer)) || !parsePmuEvent(pmu, buffer, &config))
+            {
+                continue;
+            }
+            // The scale converts counts to the unit, MiB for these events.
+            double scale = 64.0;
+            snprintf(path, sizeof(path), "%s/events/%s.scale", pmu, events[k]);
+            if (readSysfs(path, buffer, sizeof(buffer)))
+            {
+                scale = atof(buffer);
+                snprintf(path, sizeof(path), "%s/events/%s.unit", pmu, events[k]);
+                if (readSysfs(path, buffer, sizeof(buffer)) && strncmp(buffer, "MiB", 3) == 0)
+                {
+                    scale *= 1024.0 * 1024.0;
+                }
+            }
+
+            for (int c = 0; c < cpuCount; c++)
+            {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = type;
+                attr.config = config;
+                int fd = (int)syscall(SYS_perf_event_open, &attr, -1, cpus[c], -1, 0);
+                if (fd < 0)
+                {
+                    continue;
+                }
+                if (counters->count == capacity)
+                {
+                    capacity = capacity ? 2 * capacity : 16;
+                    counters->fd = (int *)realloc(counters->fd, capacity * sizeof(int));
+                    counters->socket = (int *)realloc(counters->socket, capacity * sizeof(int));
+                    counters->bytesPerCount = (double *)realloc(counters->bytesPerCount, capacity * sizeof(double));
+                }
+                int socket = cpuSocket(cpus[c]);
+                counters->fd[counters->count] = fd;
+                counters->socket[counters->count] = socket;
+                counters->bytesPerCount[counters->count] = scale;
+                counters->count++;
+                if (socket + 1 > counters->sockets)
+                {
+                    counters->sockets = socket + 1;
+                }
+            }
+        }
+    }
+    if (dir)
+    {
+        closedir(dir);
+    }
+    if (counters->count == 0)
+    {
+        free(counters);
+        return NULL;
+    }
+    return counters;
+}
+
+// Adds the bytes each socket's memory controllers have moved so far to bytes.
+void readBandwidthCounters(BandwidthCounters *counters, double *bytes)
+{
+    for (int i = 0; i < counters->count; i++)
+    {
+        unsigned long long value;
+        if (read(counters->fd[i], &value, sizeof(value)) == sizeof(value))
+        {
+            bytes[counters->socket[i]] += value * counters->bytesPerCount[i];
+        }
+    }
+}
+
+void closeBandwidthCounters(BandwidthCounters *counters)
+{
+    for (int i = 0; i < counters->count; i++)
+    {
+        close(counters->fd[i]);
+    }
+    free(counters->fd);
+    free(counters->socket);
+    free(counters->bytesPerCount);
+    free(counters);
+}
+
+PerfCounters *openPerfCounters(int threads)
+{
+    static const unsigned long long events[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+    PerfCounters *counters = (PerfCounters *)calloc(1, sizeof(PerfCounters));
+    int opened = 0, i;
+    counters->threads = threads;
+    counters->fd = (int *)malloc(threads * COUNTER_COUNT * sizeof(int));
+    for (i = 0; i < threads * COUNTER_COUNT; i++)
+    {
+        counters->fd[i] = -1;
+    }
+
+    // Each thread opens its own counters; pid 0 counts the calling thread.
+    omp_set_num_threads(threads);
+    #pragma omp parallel shared(counters, events) reduction(+ : opened)
+    {
+        int t = omp_get_thread_num();
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = events[c];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            counters->fd[t * COUNTER_COUNT + c] = fd;
+            opened += fd >= 0;
+        }
+    }
+    if (opened == 0)
+    {
+        free(counters->fd);
+        free(counters);
+        return NULL;
+    }
+    for (i = 0; i < threads * COUNTER_COUNT; i++)
+    {
+        if (counters->fd[i] >= 0)
+        {
+            counters->available[i % COUNTER_COUNT] = 1;
+        }
+    }
+    return counters;
+}
+
+// Counts are scaled up by enabled / running time in case the kernel
+// multiplexed the counters with other events.
+void readPerfCounters(PerfCounters *counters, double *events)
+{
+    for (int i = 0; i < counters->threads * COUNTER_COUNT; i++)
+    {
+        unsigned long long value[3];
+        if (counters->fd[i] >= 0 && read(counters->fd[i], value, sizeof(value)) == sizeof(value) && value[2] > 0)
+        {
+            events[i % COUNTER_COUNT] += (double)value[0] * value[1] / value[2];
+        }
+    }
+}
+
+void closePerfCounters(PerfCounters *counters)
+{
+    for (int i = 0; i < counters->threads * COUNTER_COUNT; i++)
+    {
+        if (counters->fd[i] >= 0)
+        {
+            close(counters->fd[i]);
+        }
+    }
+    free(counters->fd);
+    free(counters);
+}
+
+typedef accum_t (*GatherKernel)(const int *sources, const rank_t *contrib, int count);
+
+static accum_t gatherScalar(const int *sources, const rank_t *contrib, int count)
+{
+    accum_t sum = 0.0;
+    for (int e = 0; e < count; e++)
+    {
+        sum += contrib[sources[e]];
+    }
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Two accumulators hide the latency of back-to-back gathers. Each step
+// gathers one vector of accumulator lanes: four doubles (double and mixed,
+// widening gathered floats) or eight floats.
+static __attribute__((target("avx2"))) accum_t gatherAvx2(const int *sources, const rank_t *contrib, int count)
+{
+    int e = 0;
+#if RANK_PRECISION == PRECISION_FLOAT
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (; e + 16 <= count; e += 16)
+    {
+        __m256i idx0 = _mm256_loadu_si256((const __m256i *)(sources + e));
+        __m256i idx1 = _mm256_loadu_si256((const __m256i *)(sources + e + 8));
+        acc0 = _mm256_add_ps(acc0, _mm256_i32gather_ps(contrib, idx0, 4));
+        acc1 = _mm256_add_ps(acc1, _mm256_i32gather_ps(contrib, idx1, 4));
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    accum_t sum = _mm_cvtss_f32(_mm_add_ss(half, _mm_movehdup_ps(half)));
+#else
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    for (; e + 8 <= count; e += 8)
+    {
+        __m128i idx0 = _mm_loadu_si128((const __m128i *)(sources + e));
+        __m128i idx1 = _mm_loadu_si128((const __m128i *)(sources + e + 4));
+#if RANK_PRECISION == PRECISION_MIXED
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm_i32gather_ps(contrib, idx0, 4)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm_i32gather_ps(contrib, idx1, 4)));
+#else
+        acc0 = _mm256_add_pd(acc0, _mm256_i32gather_pd(contrib, idx0, 8));
+        acc1 = _mm256_add_pd(acc1, _mm256_i32gather_pd(contrib, idx1, 8));
+#endif
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    accum_t sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+#endif
+    for (; e < count; e++)
+    {
+        sum += contrib[sources[e]];
+    }
+    return sum;
+}
+
+static __attribute__((target("avx512f"))) accum_t gatherAvx512(const int *sources, const rank_t *contrib, int count)
+{
+    int e = 0;
+#if RANK_PRECISION == PRECISION_FLOAT
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (; e + 32 <= count; e += 32)
+    {
+        __m512i idx0 = _mm512_loadu_si512((const void *)(sources + e));
+        __m512i idx1 = _mm512_loadu_si512((const void *)(sources + e + 16));
+        acc0 = _mm512_add_ps(acc0, _mm512_i32gather_ps(idx0, contrib, 4));
+        acc1 = _mm512_add_ps(acc1, _mm512_i32gather_ps(idx1, contrib, 4));
+    }
+    accum_t sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#else
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    for (; e + 16 <= count; e += 16)
+    {
+        __m256i idx0 = _mm256_loadu_si256((const __m256i *)(sources + e));
+        __m256i idx1 = _mm256_loadu_si256((const __m256i *)(sources + e + 8));
+#if RANK_PRECISION == PRECISION_MIXED
+        acc0 = _mm512_add_pd(acc0, _mm512_cvtps_pd(_mm256_i32gather_ps(contrib, idx0, 4)));
+        acc1 = _mm512_add_pd(acc1, _mm512_cvtps_pd(_mm256_i32gather_ps(contrib, idx1, 4)));
+#else
+        acc0 = _mm512_add_pd(acc0, _mm512_i32gather_pd(idx0, contrib, 8));
+        acc1 = _mm512_add_pd(acc1, _mm512_i32gather_pd(idx1, contrib, 8));
+#endif
+    }
+    accum_t sum = _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+#endif
+    for (; e < count; e++)
+    {
+        sum += contrib[sources[e]];
+    }
+    return sum;
+}
+#endif
+
+static GatherKernel gatherKernel = gatherScalar;
+
+// Installs the requested kernel and returns the one actually used, falling
+// back to narrower kernels when the CPU lacks the instructions.
+Kernel selectKernel(Kernel kernel)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    int avx512 = __builtin_cpu_supports("avx512f");
+    int avx2 = __builtin_cpu_supports("avx2");
+    if ((kernel == KERNEL_AUTO || kernel == KERNEL_AVX512) && avx512)
+    {
+        gatherKernel = gatherAvx512;
+        return KERNEL_AVX512;
+    }
+    if ((kernel == KERNEL_AUTO || kernel == KERNEL_AVX512 || kernel == KERNEL_AVX2) && avx2)
+    {
+        gatherKernel = gatherAvx2;
+        return KERNEL_AVX2;
+    }
+#endif
+    gatherKernel = gatherScalar;
+    return KERNEL_SCALAR;
+}
+
+static accum_t sumContributions(Graph *g, const rank_t *contrib, int begin, int end)
+{
+    if (end - begin >= SIMD_MIN_DEGREE)
+    {
+        return gatherKernel(g->inSources + begin, contrib, end - begin);
+    }
+    accum_t sum = 0.0;
+    for (int e = begin; e < end; e++)
+    {
+        sum += contrib[g->inSources[e]];
+    }
+    return sum;
+}
+
+// Pure gather over the in-links: each in-link adds its source's precomputed
+// contribution. Heavy vertices are finished from their slices' partial sums.
+static void updatePageRankPull(Graph *g, Partition *part, accum_t *partial, rank_t *contrib, double *npg, double dp,
+                               double damping, const double *teleport)
+{
+    int b, h, p;
+    #pragma omp parallel shared(g, part, partial, contrib, npg, dp, damping, teleport) private(b, h, p)
+    {
+        PROFILE_START(start);
+        #pragma omp for schedule(runtime) nowait
+        for (b = 0; b < part->count; b++)
+        {
+            Block *block = &part->blocks[b];
+            if (block->heavy >= 0)
+            {
+                partial[b] = sumContributions(g, contrib, block->begin, block->end);
+                continue;
+            }
+            for (p = block->begin; p < block->end; p++)
+            {
+                npg[p] = teleportShare(teleport, g->n, p, dp, damping) +
+                         sumContributions(g, contrib, g->inOffsets[p], g->inOffsets[p + 1]);
+            }
+        }
+        PROFILE_BUSY(start);
+        #pragma omp barrier
+
+        #pragma omp for
+        for (h = 0; h < part->heavyCount; h++)
+        {
+            accum_t sum = 0.0;
+            for (b = part->heavyFirst[h]; b < part->heavyEnd[h]; b++)
+            {
+                sum += partial[b];
+            }
+            npg[part->heavy[h]] = teleportShare(teleport, g->n, part->heavy[h], dp, damping) + sum;
+        }
+    }
+}
+
+// In-links grouped by source segment, as in CSR segmenting: segment s covers
+// the sources [s * segmentSize, (s + 1) * segmentSize). Its entries are
+// entryStart[s] .. entryStart[s + 1]; entry i holds the in-links of vertex
+// targets[i] from that segment, sources[offsets[i] .. offsets[i + 1]).
+// Targets are the same ranges: the entries of segment s whose targets lie in
+// range b are blockStart[s * (count + 1) + b] .. blockStart[s * (count + 1) + b + 1].
+typedef struct
+{
+    int segmentShift;
+    int segmentSize;
+    int count;
+    int *entryStart;
+    int *targets;
+    int *offsets;
+    int *sources;
+    int *blockStart;
+} Segments;
+
+// Returns log2 of the segment size in vertices, so that the segment of a
+// source is a shift away. The largest power of two that fits is used.
+int segmentShiftFor(int n, long segmentBytes)
+{
+    if (segmentBytes <= 0)
+    {
+        long cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        segmentBytes = cache > 0 ? cache / 2 : SEGMENT_DEFAULT_BYTES;
+    }
+    int shift = 0;
+    while (shift < 30 && ((long)sizeof(rank_t) << (shift + 1)) <= segmentBytes)
+    {
+        shift++;
+    }
+    while (((n - 1) >> shift) >= SEGMENT_MAX_COUNT)
+    {
+        shift++;
+    }
+    return shift;
+}
+
+// Splits each column into its runs per segment. Relies on the columns being
+// sorted by source, as every loader leaves them, so that a vertex has at most
+// one entry per segment. Each thread counts and then fills the entries of its
+// own vertex range, so entries stay in vertex order within a segment.
+static Segments *buildSegments(Graph *g, long segmentBytes)
+{
+    Segments *seg = (Segments *)malloc(sizeof(Segments));
+    seg->segmentShift = segmentShiftFor(g->n, segmentBytes);
+    seg->segmentSize = 1 << seg->segmentShift;
+    int count = (int)(((long long)g->n + seg->segmentSize - 1) / seg->segmentSize);
+    int nt = omp_get_max_threads();
+    int *entryPos = (int *)calloc((size_t)nt * count, sizeof(int));
+    int *edgePos = (int *)calloc((size_t)nt * count, sizeof(int));
+    seg->count = count;
+    seg->entryStart = (int *)malloc((count + 1) * sizeof(int));
+
+    #pragma omp parallel num_threads(nt) shared(g, seg, entryPos, edgePos)
+    {
+        int t = omp_get_thread_num(), threads = omp_get_num_threads();
+        int begin = (int)((long long)g->n * t / threads);
+        int end = (int)((long long)g->n * (t + 1) / threads);
+        int *entries = entryPos + (size_t)t * count, *edges = edgePos + (size_t)t * count;
+        for (int v = begin; v < end; v++)
+        {
+            for (int e = g->inOffsets[v]; e < g->inOffsets[v + 1];)
+            {
+                int s = g->inSources[e] >> seg->segmentShift, first = e;
+                while (e < g->inOffsets[v + 1] && g->inSources[e] >> seg->segmentShift == s)
+                {
+                    e++;
+                }
+                entries[s]++;
+                edges[s] += e - first;
+            }
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            // Segment-major, then thread order.
+            int entryTotal = 0, edgeTotal = 0;
+            for (int s = 0; s < count; s++)
+            {
+                seg->entryStart[s] = entryTotal;
+                for (int i = 0; i < threads; i++)
+                {
+                    int entryCount = entryPos[(size_t)i * count + s], edgeCount = edgePos[(size_t)i * count + s];
+                    entryPos[(size_t)i * count + s] = entryTotal;
+                    edgePos[(size_t)i * count + s] = edgeTotal;
+                    entryTotal += entryCount;
+                    edgeTotal += edgeCount;
+                }
+            }
+            seg->entryStart[count] = entryTotal;
+            seg->targets = (int *)malloc((entryTotal > 0 ? entryTotal : 1) * sizeof(int));
+            seg->offsets = (int *)malloc((entryTotal + 1) * sizeof(int));
+            seg->sources = (int *)malloc((g->edges > 0 ? g->edges : 1) * sizeof(int));
+            seg->offsets[entryTotal] = edgeTotal;
+        }
+
+        for (int v = begin; v < end; v++)
+        {
+            for (int e = g->inOffsets[v]; e < g->inOffsets[v + 1];)
+            {
+                int s = g->inSources[e] >> seg->segmentShift;
+                int i = entries[s]++;
+                seg->targets[i] = v;
+                seg->offsets[i] = edges[s];
+                while (e < g->inOffsets[v + 1] && g->inSources[e] >> seg->segmentShift == s)
+                {
+                    seg->sources[edges[s]++] = g->inSources[e++];
+                }
+            }
+        }
+    }
+
+    free(entryPos);
+    free(edgePos);
+
+    // Entries are in target order within a segment, so each target range is
+    // found by binary search.
+    seg->blockStart = (int *)malloc((size_t)count * (count + 1) * sizeof(int));
+    int i;
+    #pragma omp parallel for shared(seg, count) private(i)
+    for (i = 0; i < count * (count + 1); i++)
+    {
+        int s = i / (count + 1), b = i % (count + 1);
+        long long target = (long long)b * seg->segmentSize;
+        int low = seg->entryStart[s], high = seg->entryStart[s + 1];
+        while (low < high)
+        {
+            int mid = low + (high - low) / 2;
+            if (seg->targets[mid] < target)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        seg->blockStart[i] = low;
+    }
+    return seg;
+}
+
+static void freeSegments(Segments *seg)
+{
+    free(seg->entryStart);
+    free(seg->targets);
+    free(seg->offsets);
+    free(seg->sources);
+    free(seg->blockStart);
+    free(seg);
+}
+
+// Two passes, after Cagra. The gather pass sums each entry into partial[i],
+// taking entries in segment order so that the threads share one segment's
+// contributions in cache; its writes are sequential. The merge pass then
+// adds each target range's entries from every segment, so the ranks being
+// summed stay in cache too.
+static void updatePageRankBlocked(Graph *g, Segments *seg, accum_t *partial, rank_t *contrib, double *npg, double dp,
+                                  double damping, const double *teleport)
+{
+    int i, b, v;
+    int entries = seg->entryStart[seg->count];
+    #pragma omp parallel shared(g, seg, partial, contrib, npg, dp, damping, teleport, entries) private(i, b, v)
+    {
+        PROFILE_START(start);
+        #pragma omp for schedule(dynamic, 1024) nowait
+        for (i = 0; i < entries; i++)
+        {
+            int begin = seg->offsets[i], count = seg->offsets[i + 1] - begin;
+            if (count >= SIMD_MIN_DEGREE)
+            {
+                partial[i] = gatherKernel(seg->sources + begin, contrib, count);
+                continue;
+            }
+            accum_t sum = 0.0;
+            for (int e = begin; e < begin + count; e++)
+            {
+                sum += contrib[seg->sources[e]];
+            }
+            partial[i] = sum;
+        }
+        PROFILE_BUSY(start);
+        #pragma omp barrier
+
+        PROFILE_RESTART(start);
+        #pragma omp for schedule(dynamic, 1) nowait
+        for (b = 0; b < seg->count; b++)
+        {
+            int begin = b * seg->segmentSize;
+            int end = g->n - begin > seg->segmentSize ? begin + seg->segmentSize : g->n;
+            for (v = begin; v < end; v++)
+            {
+                npg[v] = teleportShare(teleport, g->n, v, dp, damping);
+            }
+            for (int s = 0; s < seg->count; s++)
+            {
+                int *range = seg->blockStart + (size_t)s * (seg->count + 1) + b;
+                for (i = range[0]; i < range[1]; i++)
+                {
+                    npg[seg->targets[i]] += partial[i];
+                }
+            }
+        }
+        PROFILE_BUSY(start);
+    }
+}
+
+// Change of a rank relative to its new value; a rank that stays 0 has not
+// changed.
+static inline double relativeChange(double change, double value)
+{
+    return change > 0.0 ? change / fabs(value) : 0.0;
+}
+
+// The residual in norm of an iteration, given its largest change, the sum of
+// its changes and its largest relative change.
+static inline double normOf(Norm norm, double max, double l1, double relative)
+{
+    return norm == NORM_L1 ? l1 : norm == NORM_RELATIVE ? relative : max;
+}
+
+double rankChange(Norm norm, const double *opg, const double *npg, int n)
+{
+    double max = 0.0, l1 = 0.0, relative = 0.0;
+    int i;
+    #pragma omp parallel for shared(opg, npg, norm) private(i) reduction(max : max, relative) reduction(+ : l1)
+    for (i = 0; i < n; i++)
+    {
+        double change = fabs(npg[i] - opg[i]);
+        max = fmax(max, change);
+        l1 += change;
+        if (norm == NORM_RELATIVE)
+        {
+            relative = fmax(relative, relativeChange(change, npg[i]));
+        }
+    }
+    return normOf(norm, max, l1, relative);
+}
+
+// Top-k selection. top holds the size = min(k + 1, n) highest-ranked
+// vertices, highest first, ties going to the lower ID; the extra one shows
+// how far the k-th is from the rest. Each thread keeps the best size of its
+// share of the vertices in candidates[t * size ..] (counts[t] of them), so a
+// selection costs a pass over the ranks plus a merge of threads * size
+// candidates, not a sort of all n.
+typedef struct
+{
+    int k;
+    int size;
+    int *top;
+    int *candidates;
+    int *counts;
+} TopSelection;
+
+static TopSelection *createTopSelection(int n, int k, int threads)
+{
+    TopSelection *sel = (TopSelection *)malloc(sizeof(TopSelection));
+    sel->k = k < n ? k : n;
+    sel->size = k < n ? k + 1 : n;
+    sel->top = (int *)malloc(sel->size * sizeof(int));
+    sel->candidates = (int *)malloc((size_t)threads * sel->size * sizeof(int));
+    sel->counts = (int *)malloc(threads * sizeof(int));
+    return sel;
+}
+
+static void freeTopSelection(TopSelection *sel)
+{
+    free(sel->top);
+    free(sel->candidates);
+    free(sel->counts);
+    free(sel);
+}
+
+// Whether vertex a ranks below vertex b.
+static inline int ranksBelow(const double *ranks, int a, int b)
+{
+    return ranks[a] < ranks[b] || (ranks[a] == ranks[b] && a > b);
+}
+
+// Restores the min-heap order (lowest-ranked at the root) below i.
+static void siftDownTop(const double *ranks, int *heap, int count, int i)
+{
+    while (2 * i + 1 < count)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < count && ranksBelow(ranks, heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        if (!ranksBelow(ranks, heap[child], heap[i]))
+        {
+            break;
+        }
+        int t = heap[i];
+        heap[i] = heap[child];
+        heap[child] = t;
+        i = child;
+    }
+}
+
+// Offers v to a heap of the best size vertices seen so far; returns the new
+// count. Most vertices lose to the root and cost one comparison.
+static inline int offerTop(const double *ranks, int *heap, int count, int size, int v)
+{
+    if (count < size)
+    {
+        int i = count++;
+        heap[i] = v;
+        while (i > 0 && ranksBelow(ranks, heap[i], heap[(i - 1) / 2]))
+        {
+            int parent = (i - 1) / 2;
+            heap[i] = heap[parent];
+            heap[parent] = v;
+            i = parent;
+        }
+    }
+    else if (ranksBelow(ranks, heap[0], v))
+    {
+        heap[0] = v;
+        siftDownTop(ranks, heap, count, 0);
+    }
+    return count;
+}
+
+// Fills sel->top from ranks. Called by every thread of a team (the team of
+// the enclosing parallel region, if any, of at most the threads sel was
+// created for).
+static void selectTop(TopSelection *sel, const double *ranks, int n)
+{
+    int t = omp_get_thread_num(), threads = omp_get_num_threads(), size = sel->size;
+    int *heap = sel->candidates + (size_t)t * size, count = 0, v;
+
+    #pragma omp for schedule(static) nowait
+    for (v = 0; v < n; v++)
+    {
+        count = offerTop(ranks, heap, count, size, v);
+    }
+    sel->counts[t] = count;
+    #pragma omp barrier
+
+    #pragma omp single
+    {
+        int *top = sel->top;
+        count = 0;
+        for (int i = 0; i < threads; i++)
+        {
+            for (int c = 0; c < sel->counts[i]; c++)
+            {
+                count = offerTop(ranks, top, count, size, sel->candidates[(size_t)i * size + c]);
+            }
+        }
+        // Heapsort: moving each root (the lowest left) to the end leaves the
+        // highest first.
+        for (int end = count - 1; end > 0; end--)
+        {
+            int root = top[0];
+            top[0] = top[end];
+            top[end] = root;
+            siftDownTop(ranks, top, end, 0);
+        }
+    }
+}
+
+// Whether the k highest ranks, and their order, are settled: no more than
+// bound separates the ranks from the solution in L1, so the difference of
+// any two ranks can still change by at most bound, and each of the k must
+// lead the next by more than that.
+static int topSettled(const TopSelection *sel, const double *ranks, double bound)
+{
+    for (int i = 0; i + 1 < sel->size; i++)
+    {
+        if (ranks[sel->top[i]] - ranks[sel->top[i + 1]] <= bound)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Distance in L1 of the ranks of a Jacobi iteration from the solution, given
+// the L1 change in that iteration. Each iteration shrinks the error by
+// damping, so the error e after a change l1 satisfies e <= damping * (e + l1).
+static double topBound(double damping, double l1)
+{
+    return damping / (1.0 - damping) * l1;
+}
+
+void selectTopRanks(const double *ranks, int n, int k, int *top)
+{
+    if (k <= 0 || n <= 0)
+    {
+        return;
+    }
+    TopSelection *sel = createTopSelection(n, k, omp_get_max_threads());
+    #pragma omp parallel shared(sel, ranks)
+    selectTop(sel, ranks, n);
+    memcpy(top, sel->top, sel->k * sizeof(int));
+    freeTopSelection(sel);
+}
+
+// A checkpoint file holds a rank vector as a header followed by n doubles.
+// iterations counts every iteration that produced the ranks, across resumes;
+// residual is the convergence residual of the last one.
+#define CHECKPOINT_MAGIC "PRRANKS"
+#define CHECKPOINT_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int64_t n;
+    int64_t iterations;
+    double residual;
+} CheckpointHeader;
+
+// Writes to filename.tmp and renames it over filename, so a run killed while
+// writing leaves the previous checkpoint intact. Returns 1 on success.
+static int writeCheckpoint(const char *filename, int n, const double *ranks, int iterations, double residual)
+{
+    CheckpointHeader header = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, 0, n, iterations, residual};
+    size_t length = strlen(filename);
+    char *tmpname = (char *)malloc(length + 5);
+    memcpy(tmpname, filename, length);
+    memcpy(tmpname + length, ".tmp", 5);
+
+    FILE *fout = fopen(tmpname, "wb");
+    int written = fout &&
+                  fwrite(&header, sizeof(header), 1, fout) == 1 &&
+                  fwrite(ranks, sizeof(double), n, fout) == (size_t)n &&
+                  fflush(fout) == 0 && fsync(fileno(fout)) == 0;
+    if (fout && fclose(fout) != 0)
+    {
+        written = 0;
+    }
+    if (!written || rename(tmpname, filename) != 0)
+    {
+        printf("Error: Could not write checkpoint %s\n", filename);
+        remove(tmpname);
+        written = 0;
+    }
+    free(tmpname);
+    return written;
+}
+
+// Copies ranks, indexed by the vertices of a reordered g, to original,
+// indexed by input vertex IDs.
+static void toInputOrder(Graph *g, const double *ranks, double *original)
+{
+    int v;
+    #pragma omp parallel for shared(g, ranks, original) private(v)
+    for (v = 0; v < g->n; v++)
+    {
+        original[g->originalIds[v]] = ranks[v];
+    }
+}
+
+// Writes ranks, indexed by g's vertices, as a checkpoint in input vertex IDs.
+int saveCheckpoint(Graph *g, const char *filename, const double *ranks, int iterations, double residual)
+{
+    if (!g->originalIds)
+    {
+        return writeCheckpoint(filename, g->n, ranks, iterations, residual);
+    }
+    double *original = (double *)malloc(g->n * sizeof(double));
+    toInputOrder(g, ranks, original);
+    int written = writeCheckpoint(filename, g->n, original, iterations, residual);
+    free(original);
+    return written;
+}
+
+// Reads the ranks of a checkpoint for g, indexed by g's vertices. To resume,
+// the checkpoint must have exactly n ranks and *iterations receives its
+// iteration count. To warm-start, *iterations is 0 and the checkpoint may come
+// from an older, smaller graph: vertices it does not cover start at 1 / n, and
+// the vector is rescaled to sum to 1.
+double *readCheckpoint(Graph *g, const char *filename, int resume, int *iterations, double *residual)
+{
+    int n = g->n;
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+
+    CheckpointHeader header;
+    double *ranks = (double *)malloc(n * sizeof(double));
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CHECKPOINT_VERSION ||
+        header.n <= 0 || header.n > n || (resume && header.n != n) ||
+        header.iterations < 0 || header.iterations > INT32_MAX ||
+        fread(ranks, sizeof(double), header.n, file) != (size_t)header.n)
+    {
+        printf("Error: %s is not a checkpoint for this graph.\n", filename);
+        fclose(file);
+        free(ranks);
+        return NULL;
+    }
+    fclose(file);
+
+    double total = 0.0;
+    int i;
+    #pragma omp parallel for shared(ranks, header) private(i) reduction(+ : total)
+    for (i = 0; i < n; i++)
+    {
+        if (i >= header.n)
+        {
+            ranks[i] = 1.0 / n;
+        }
+        total += ranks[i];
+    }
+    if (!(total > 0.0))
+    {
+        printf("Error: %s is not a checkpoint for this graph.\n", filename);
+        free(ranks);
+        return NULL;
+    }
+    if (header.n != n)
+    {
+        #pragma omp parallel for shared(ranks, total) private(i)
+        for (i = 0; i < n; i++)
+        {
+            ranks[i] /= total;
+        }
+    }
+
+    if (g->originalIds)
+    {
+        double *original = ranks;
+        ranks = (double *)malloc(n * sizeof(double));
+        #pragma omp parallel for shared(g, ranks, original) private(i)
+        for (i = 0; i < n; i++)
+        {
+            ranks[i] = original[g->originalIds[i]];
+        }
+        free(original);
+    }
+
+    *iterations = resume ? (int)header.iterations : 0;
+    *residual = header.residual;
+    return ranks;
+}
+
+// Runs every iteration inside one parallel region. The update loop also
+// produces the next iteration's contributions, dangling sum and the residual
+// max |npg - opg|, so each iteration is a single sweep followed by a pointer
+// swap. Ranks are kept as rank_t internally; opg holds the initial ranks on
+// entry and the latest ranks on return, and doubles as the staging buffer for
+// periodic checkpoints.
+//
+// For the gauss-seidel engine the next buffers alias the current ones, giving an
+// asynchronous Gauss-Seidel sweep: each vertex gathers whatever contributions
+// are current, including ones already updated this iteration. Those reads
+// race with other threads' stores by design; aligned loads and stores of
+// rank_t are not torn on the platforms we target. The dangling sum of a
+// sweep is stale for the vertices updated early in it and leaks rank mass,
+// so each sweep is followed by a pass scaling the ranks back to sum 1;
+// without it the sweeps converge slower than Jacobi iterations.
+static Stats computePageRankFused(Graph *g, Partition *part, double *opg, double *invOutLinks, const Options *options)
+{
+    int maxIterations = options->maxIterations;
+    double damping = options->damping;
+    const double *teleport = options->teleport;
+    int inPlace = options->engine == ENGINE_GAUSS_SEIDEL;
+    int interval = options->checkpointFile ? options->checkpointInterval : 0;
+    // Gauss-Seidel sweeps do not shrink the error by damping each time.
+    TopSelection *sel = options->topK > 0 && !inPlace ? createTopSelection(g->n, options->topK, options->threads) : NULL;
+    rank_t *ranks = (rank_t *)malloc(g->n * sizeof(rank_t));
+    rank_t *contrib = (rank_t *)malloc(g->n * sizeof(rank_t));
+    rank_t *next = inPlace ? ranks : (rank_t *)malloc(g->n * sizeof(rank_t));
+    rank_t *nextContrib = inPlace ? contrib : (rank_t *)malloc(g->n * sizeof(rank_t));
+    accum_t *partial = (accum_t *)malloc(part->count * sizeof(accum_t));
+    Norm norm = options->norm;
+    double dangling = 0.0, residual = 0.0, lastResidual = 0.0, l1 = 0.0, relative = 0.0, bound = 0.0, dp;
+    double total = 0.0, scale = 1.0;
+    int iterations = options->startIteration, converged = 0, check = 0;
+
+    firstTouch(part, ranks, sizeof(rank_t));
+    firstTouch(part, contrib, sizeof(rank_t));
+    if (!inPlace)
+    {
+        firstTouch(part, next, sizeof(rank_t));
+        firstTouch(part, nextContrib, sizeof(rank_t));
+    }
+
+    #pragma omp parallel shared(g, part, opg, ranks, next, contrib, nextContrib, partial, invOutLinks, damping, teleport, norm, dangling, residual, lastResidual, l1, relative, bound, dp, total, scale, iterations, converged, check, sel)
+    {
+        int p, b, h;
+        accum_t rank;
+
+        #pragma omp for reduction(+ : dangling)
+        for (p = 0; p < g->n; p++)
+        {
+            ranks[p] = (rank_t)opg[p];
+            contrib[p] = (rank_t)(opg[p] * invOutLinks[p]);
+            if (g->outLinks[p] == 0)
+            {
+                dangling += opg[p];
+            }
+        }
+        #pragma omp single
+        {
+            dp = damping * dangling / g->n;
+            dangling = 0.0;
+        }
+
+        while (!converged && iterations < maxIterations)
+        {
+            PROFILE_START(start);
+            #pragma omp for schedule(runtime) reduction(max : residual, relative) reduction(+ : dangling, l1, total) nowait
+            for (b = 0; b < part->count; b++)
+            {
+                Block *block = &part->blocks[b];
+                if (block->heavy >= 0)
+                {
+                    partial[b] = sumContributions(g, contrib, block->begin, block->end);
+                    continue;
+                }
+                for (p = block->begin; p < block->end; p++)
+                {
+                    rank = (accum_t)teleportShare(teleport, g->n, p, dp, damping) +
+                           sumContributions(g, contrib, g->inOffsets[p], g->inOffsets[p + 1]);
+                    residual = fmax(residual, fabs(rank - ranks[p]));
+                    l1 += fabs(rank - ranks[p]);
+                    if (norm == NORM_RELATIVE)
+                    {
+                        relative = fmax(relative, relativeChange(fabs(rank - ranks[p]), rank));
+                    }
+                    next[p] = (rank_t)rank;
+                    nextContrib[p] = (rank_t)(rank * invOutLinks[p]);
+                    total += rank;
+                    if (g->outLinks[p] == 0)
+                    {
+                        dangling += rank;
+                    }
+                }
+            }
+            PROFILE_BUSY(start);
+            #pragma omp barrier
+
+            if (part->heavyCount > 0)
+            {
+                #pragma omp for reduction(max : residual, relative) reduction(+ : dangling, l1, total)
+                for (h = 0; h < part->heavyCount; h++)
+                {
+                    p = part->heavy[h];
+                    rank = (accum_t)teleportShare(teleport, g->n, p, dp, damping);
+                    for (b = part->heavyFirst[h]; b < part->heavyEnd[h]; b++)
+                    {
+                        rank += partial[b];
+                    }
+                    residual = fmax(residual, fabs(rank - ranks[p]));
+                    l1 += fabs(rank - ranks[p]);
+                    if (norm == NORM_RELATIVE)
+                    {
+                        relative = fmax(relative, relativeChange(fabs(rank - ranks[p]), rank));
+                    }
+                    next[p] = (rank_t)rank;
+                    nextContrib[p] = (rank_t)(rank * invOutLinks[p]);
+                    total += rank;
+                    if (g->outLinks[p] == 0)
+                    {
+                        dangling += rank;
+                    }
+                }
+            }
+
+            #pragma omp single
+            {
+                PROFILE_PHASE(PHASE_UPDATE, start);
+                rank_t *t = ranks;
+                ranks = next;
+                next = t;
+                t = contrib;
+                contrib = nextContrib;
+                nextContrib = t;
+                scale = inPlace ? 1.0 / total : 1.0;
+                dp = damping * dangling * scale / g->n;
+                dangling = 0.0;
+                total = 0.0;
+                PROFILE_TRACE(l1, residual);
+                iterations++;
+                lastResidual = normOf(norm, residual, l1, relative);
+                check = iterations % options->checkInterval == 0;
+                converged = check && lastResidual <= options->tolerance;
+                bound = topBound(damping, l1);
+                residual = 0.0;
+                l1 = 0.0;
+                relative = 0.0;
+                PROFILE_PHASE(PHASE_CONVERGENCE, start);
+            }
+
+            if (inPlace)
+            {
+                #pragma omp for
+                for (p = 0; p < g->n; p++)
+                {
+                    ranks[p] = (rank_t)(ranks[p] * scale);
+                    contrib[p] = (rank_t)(contrib[p] * scale);
+                }
+            }
+
+            if (sel && check && !converged && iterations < maxIterations)
+            {
+                #pragma omp for
+                for (p = 0; p < g->n; p++)
+                {
+                    opg[p] = ranks[p];
+                }
+                selectTop(sel, opg, g->n);
+                #pragma omp single
+                converged = topSettled(sel, opg, bound);
+            }
+
+            // The final ranks are saved by the caller.
+            if (interval > 0 && iterations % interval == 0 && !converged && iterations < maxIterations)
+            {
+                #pragma omp for
+                for (p = 0; p < g->n; p++)
+                {
+                    opg[p] = ranks[p];
+                }
+                #pragma omp single
+                saveCheckpoint(g, options->checkpointFile, opg, iterations, lastResidual);
+            }
+        }
+
+        #pragma omp for
+        for (p = 0; p < g->n; p++)
+        {
+            opg[p] = ranks[p];
+        }
+    }
+
+    free(ranks);
+    free(contrib);
+    if (!inPlace)
+    {
+        free(next);
+        free(nextContrib);
+    }
+    free(partial);
+    if (sel)
+    {
+        freeTopSelection(sel);
+    }
+    Stats stats = {iterations, (long long)(iterations - options->startIteration) * g->edges, lastResidual};
+    return stats;
+}
+
+// Moves the residual of v into its rank and pushes the damped share to each
+// out-neighbour. Residuals may be negative after an incremental update, so
+// activity is judged on |residual|. In sparse rounds, neighbours whose
+// residual crosses the tolerance are appended to the next frontier once.
+// Returns the links visited.
+static int pushVertex(Graph *g, int v, double *x, double *residual, double damping, double tolerance,
+                      char *queued, int *frontier, int *frontierSize)
+{
+    double rv;
+    #pragma omp atomic capture
+    {
+        rv = residual[v];
+        residual[v] = 0.0;
+    }
+    if (rv == 0.0)
+    {
+        return 0;
+    }
+    x[v] += rv;
+
+    int begin = g->outOffsets[v], end = g->outOffsets[v + 1];
+    if (begin == end)
+    {
+        return 0;
+    }
+    double delta = damping * rv / (end - begin);
+    for (int e = begin; e < end; e++)
+    {
+        int w = g->outTargets[e];
+        double old;
+        #pragma omp atomic capture
+        {
+            old = residual[w];
+            residual[w] += delta;
+        }
+        if (frontier && fabs(old + delta) > tolerance)
+        {
+            char wasQueued;
+            #pragma omp atomic capture
+            {
+                wasQueued = queued[w];
+                queued[w] = 1;
+            }
+            if (!wasQueued)
+            {
+                int slot;
+                #pragma omp atomic capture
+                slot = (*frontierSize)++;
+                frontier[slot] = w;
+            }
+        }
+    }
+    return end - begin;
+}
+
+// Scales x to sum 1 into ranks and returns the old sum. Dangling rank is
+// spread like the teleport, so this gives the ranks of the other engines.
+static double normalizeRanks(int n, double *x, double *ranks)
+{
+    double total = 0.0;
+    int v;
+    #pragma omp parallel for shared(x) private(v) reduction(+ : total)
+    for (v = 0; v < n; v++)
+    {
+        total += x[v];
+    }
+    #pragma omp parallel for shared(x, ranks, total) private(v)
+    for (v = 0; v < n; v++)
+    {
+        ranks[v] = x[v] / total;
+    }
+    return total;
+}
+
+static double maxResidual(int n, double *residual)
+{
+    double largest = 0.0;
+    int v;
+    #pragma omp parallel for shared(residual) private(v) reduction(max : largest)
+    for (v = 0; v < n; v++)
+    {
+        largest = fmax(largest, fabs(residual[v]));
+    }
+    return largest;
+}
+
+// Scales normalized ranks to the unnormalized push solution x, by
+// (1 - d) / (1 - d + d * dangling mass).
+static void scaleRanksForPush(Graph *g, const double *ranks, double *x, double damping)
+{
+    double dangling = 0.0;
+    int v;
+    #pragma omp parallel for shared(g, ranks) private(v) reduction(+ : dangling)
+    for (v = 0; v < g->n; v++)
+    {
+        if (g->outLinks[v] == 0)
+        {
+            dangling += ranks[v];
+        }
+    }
+    double scale = (1.0 - damping) / (1.0 - damping + damping * dangling);
+    #pragma omp parallel for shared(x, ranks, scale) private(v)
+    for (v = 0; v < g->n; v++)
+    {
+        x[v] = ranks[v] * scale;
+    }
+}
+
+// Sets residual[v] = (1 - d) * t[v] + d * sum over in-links u of x[u] / outLinks[u]
+// - x[v] for the vertices marked in affected, or for all of them if it is NULL.
+// t is the teleport vector, or 1 / n everywhere.
+static void computeResiduals(Graph *g, double *x, double *residual, const char *affected, double damping,
+                             const double *teleport)
+{
+    int v;
+    #pragma omp parallel for shared(g, x, residual, affected, damping, teleport) private(v) schedule(dynamic, 1024)
+    for (v = 0; v < g->n; v++)
+    {
+        if (!affected || affected[v])
+        {
+            double sum = 0.0;
+            for (int e = g->inOffsets[v]; e < g->inOffsets[v + 1]; e++)
+            {
+                int u = g->inSources[e];
+                sum += x[u] / g->outLinks[u];
+            }
+            residual[v] = (1.0 - damping) * (teleport ? teleport[v] : 1.0 / g->n) + damping * sum - x[v];
+        }
+    }
+}
+
+// Pushes residuals until every |residual| is at most options->tolerance / n,
+// i.e. the tolerance relative to the average rank, or until
+// options->maxIterations rounds have run.
+// Each round pushes all active vertices, from a frontier list while it is
+// small and by scanning every vertex once it is not. x and residual hold the
+// unnormalized solution of x = (1 - d) * t + d * P * x, with t the teleport
+// vector (or 1 / n everywhere), where P leaves out the
+// dangling vertices' links. The returned residual is the largest |residual|
+// left, in the same unnormalized units. With a checkpoint file in options,
+// the normalized ranks are saved every interval rounds.
+static Stats pushResiduals(Graph *g, double *x, double *residual, const Options *options)
+{
+    int n = g->n, maxIterations = options->maxIterations;
+    double damping = options->damping, tolerance = options->tolerance / n;
+    char *queued = (char *)malloc(n);
+    int *frontier = (int *)malloc(n * sizeof(int));
+    int *nextFrontier = (int *)malloc(n * sizeof(int));
+    int frontierSize = 0, nextSize = 0;
+    int interval = options->checkpointFile ? options->checkpointInterval : 0;
+    Stats stats = {options->startIteration, 0, 0.0};
+    double *saved = NULL;
+    int i, v;
+
+    buildOutEdges(g);
+
+    #pragma omp parallel for shared(residual, queued, frontier, frontierSize) private(v)
+    for (v = 0; v < n; v++)
+    {
+        queued[v] = fabs(residual[v]) > tolerance;
+        if (queued[v])
+        {
+            int slot;
+            #pragma omp atomic capture
+            slot = frontierSize++;
+            frontier[slot] = v;
+        }
+    }
+    int dense = frontierSize > n / PUSH_DENSE_DIVISOR;
+
+    while (stats.iterations < maxIterations && frontierSize > 0)
+    {
+        PROFILE_START(start);
+        long long traversals = 0;
+        if (dense)
+        {
+            #pragma omp parallel for shared(g, x, residual) private(v) reduction(+ : traversals) schedule(dynamic, 1024)
+            for (v = 0; v < n; v++)
+            {
+                if (fabs(residual[v]) > tolerance)
+                {
+                    traversals += pushVertex(g, v, x, residual, damping, tolerance, NULL, NULL, NULL);
+                }
+            }
+
+            // Rebuild the frontier from scratch after a dense round.
+            nextSize = 0;
+            #pragma omp parallel for shared(residual, queued, nextFrontier, nextSize) private(v)
+            for (v = 0; v < n; v++)
+            {
+                queued[v] = fabs(residual[v]) > tolerance;
+                if (queued[v])
+                {
+                    int slot;
+                    #pragma omp atomic capture
+                    slot = nextSize++;
+                    nextFrontier[slot] = v;
+                }
+            }
+        }
+        else
+        {
+            nextSize = 0;
+            #pragma omp parallel for shared(g, x, residual, queued, frontier, nextFrontier, nextSize) private(i, v) reduction(+ : traversals) schedule(dynamic, 64)
+            for (i = 0; i < frontierSize; i++)
+            {
+                v = frontier[i];
+                // Other threads may be queueing v through pushVertex.
+                #pragma omp atomic write
+                queued[v] = 0;
+                if (fabs(residual[v]) > tolerance)
+                {
+                    traversals += pushVertex(g, v, x, residual, damping, tolerance, queued, nextFrontier, &nextSize);
+                }
+            }
+        }
+
+        int *t = frontier;
+        frontier = nextFrontier;
+        nextFrontier = t;
+        frontierSize = nextSize;
+        dense = frontierSize > n / PUSH_DENSE_DIVISOR;
+        stats.edgeTraversals += traversals;
+        stats.iterations++;
+        PROFILE_PHASE(PHASE_UPDATE, start);
+#if PAGERANK_PROFILE
+        if (activeProfile)
+        {
+            double l1 = 0.0, max = 0.0;
+            #pragma omp parallel for shared(residual) private(v) reduction(+ : l1) reduction(max : max)
+            for (v = 0; v < n; v++)
+            {
+                l1 += fabs(residual[v]);
+                max = fmax(max, fabs(residual[v]));
+            }
+            PROFILE_TRACE(l1, max);
+        }
+#endif
+
+        if (interval > 0 && stats.iterations % interval == 0 && frontierSize > 0 && stats.iterations < maxIterations)
+        {
+            if (!saved)
+            {
+                saved = (double *)malloc(n * sizeof(double));
+            }
+            double total = normalizeRanks(n, x, saved);
+            saveCheckpoint(g, options->checkpointFile, saved, stats.iterations, maxResidual(n, residual) / total);
+        }
+    }
+
+    stats.residual = maxResidual(n, residual);
+    free(queued);
+    free(frontier);
+    free(nextFrontier);
+    free(saved);
+    return stats;
+}
+
+// Residual-push PageRank: every vertex starts with rank 0 and its teleport
+// share of 1 - d as residual, or, given start ranks, with those ranks and whatever residual
+// they leave. Ranks are kept in double for the atomic updates. On return
+// opg holds the ranks.
+static Stats computePageRankPush(Graph *g, double *opg, const Options *options)
+{
+    int n = g->n;
+    double *x = (double *)malloc(n * sizeof(double));
+    double *residual = (double *)malloc(n * sizeof(double));
+    int v;
+
+    if (options->startRanks)
+    {
+        buildOutEdges(g);
+        scaleRanksForPush(g, options->startRanks, x, options->damping);
+        computeResiduals(g, x, residual, NULL, options->damping, options->teleport);
+    }
+    else
+    {
+        #pragma omp parallel for shared(x, residual, options) private(v)
+        for (v = 0; v < n; v++)
+        {
+            x[v] = 0.0;
+            residual[v] = (1.0 - options->damping) * (options->teleport ? options->teleport[v] : 1.0 / n);
+        }
+    }
+
+    Stats stats = pushResiduals(g, x, residual, options);
+    stats.residual /= normalizeRanks(n, x, opg);
+    free(x);
+    free(residual);
+    return stats;
+}
+
+void freeEdgeBatch(EdgeBatch *batch)
+{
+    free(batch->src);
+    free(batch->dst);
+    free(batch->remove);
+    free(batch);
+}
+
+// Reads a batch file with one "+ u v" (insert) or "- u v" (remove) per line,
+// in input vertex IDs, and relabels it to g's vertices.
+EdgeBatch *readEdgeBatch(Graph *g, const char *filename)
+{
+    int n = g->n;
+    FILE *file = fopen(filename, "r");
+    if (!file)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+
+    EdgeBatch *batch = (EdgeBatch *)malloc(sizeof(EdgeBatch));
+    int capacity = 1024;
+    batch->count = 0;
+    batch->src = (int *)malloc(capacity * sizeof(int));
+    batch->dst = (int *)malloc(capacity * sizeof(int));
+    batch->remove = (char *)malloc(capacity);
+
+    char op;
+    int u, v, read;
+    while ((read = fscanf(file, " %c %d %d", &op, &u, &v)) == 3)
+    {
+        if ((op != '+' && op != '-') || u < 0 || v < 0 || u >= n || v >= n)
+        {
+            break;
+        }
+        if (batch->count == capacity)
+        {
+            capacity *= 2;
+            batch->src = (int *)realloc(batch->src, capacity * sizeof(int));
+            batch->dst = (int *)realloc(batch->dst, capacity * sizeof(int));
+            batch->remove = (char *)realloc(batch->remove, capacity);
+        }
+        batch->src[batch->count] = u;
+        batch->dst[batch->count] = v;
+        batch->remove[batch->count] = op == '-';
+        batch->count++;
+    }
+    int complete = read == EOF;
+    fclose(file);
+    if (!complete)
+    {
+        printf("Error: Invalid edge update or out-of-bounds node.\n");
+        freeEdgeBatch(batch);
+        return NULL;
+    }
+
+    if (g->originalIds)
+    {
+        int *newIds = (int *)malloc(n * sizeof(int));
+        int i;
+        #pragma omp parallel for shared(g, newIds) private(i)
+        for (i = 0; i < n; i++)
+        {
+            newIds[g->originalIds[i]] = i;
+        }
+        for (i = 0; i < batch->count; i++)
+        {
+            batch->src[i] = newIds[batch->src[i]];
+            batch->dst[i] = newIds[batch->dst[i]];
+        }
+        free(newIds);
+    }
+    return batch;
+}
+
+static int compareEdges(const void *a, const void *b)
+{
+    const int *x = (const int *)a, *y = (const int *)b;
+    if (x[0] != y[0])
+    {
+        return (x[0] > y[0]) - (x[0] < y[0]);
+    }
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+// Index of the first (target, source) pair in edges[0 .. count) that is not
+// before (v, u).
+static int lowerBoundEdge(const int *edges, int count, int v, int u)
+{
+    int lo = 0, hi = count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (edges[2 * mid] < v || (edges[2 * mid] == v && edges[2 * mid + 1] < u))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Updates already built out-link rows for a batch that applyEdgeBatch has
+// validated: each row is copied, its removed targets are swapped out and its
+// insertions appended. Rows are unordered, so this avoids a full scatter.
+static void applyEdgeBatchToOutEdges(Graph *g, EdgeBatch *batch, int *outLinks, int edges)
+{
+    int n = g->n, u;
+    int removals = 0;
+    for (int i = 0; i < batch->count; i++)
+    {
+        removals += batch->remove[i];
+    }
+    int insertions = batch->count - removals;
+
+    // (source, target) pairs, sorted so each row finds its changes by binary search.
+    int *removed = (int *)malloc((removals > 0 ? removals : 1) * 2 * sizeof(int));
+    int *inserted = (int *)malloc((insertions > 0 ? insertions : 1) * 2 * sizeof(int));
+    for (int i = 0, r = 0, a = 0; i < batch->count; i++)
+    {
+        int *pair = batch->remove[i] ? &removed[2 * r++] : &inserted[2 * a++];
+        pair[0] = batch->src[i];
+        pair[1] = batch->dst[i];
+    }
+    qsort(removed, removals, 2 * sizeof(int), compareEdges);
+    qsort(inserted, insertions, 2 * sizeof(int), compareEdges);
+
+    int *outOffsets = (int *)malloc((n + 1) * sizeof(int));
+    int *outTargets = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+    for (u = 0; u < n; u++)
+    {
+        outOffsets[u + 1] = outLinks[u];
+    }
+    prefixSum(outOffsets, n);
+
+    #pragma omp parallel for shared(g, outOffsets, outTargets, removed, inserted) private(u) schedule(dynamic, 1024)
+    for (u = 0; u < n; u++)
+    {
+        int *row = outTargets + outOffsets[u];
+        int length = g->outOffsets[u + 1] - g->outOffsets[u];
+        memcpy(row, g->outTargets + g->outOffsets[u], length * sizeof(int));
+        for (int r = lowerBoundEdge(removed, removals, u, 0); r < removals && removed[2 * r] == u; r++)
+        {
+            for (int e = 0; e < length; e++)
+            {
+                if (row[e] == removed[2 * r + 1])
+                {
+                    row[e] = row[--length];
+                    break;
+                }
+            }
+        }
+        for (int a = lowerBoundEdge(inserted, insertions, u, 0); a < insertions && inserted[2 * a] == u; a++)
+        {
+            row[length++] = inserted[2 * a + 1];
+        }
+    }
+
+    free(removed);
+    free(inserted);
+    free(g->outOffsets);
+    free(g->outTargets);
+    g->outOffsets = outOffsets;
+    g->outTargets = outTargets;
+}
+
+// Rebuilds the in-link columns of g with the batch applied. Each column is a
+// merge of its old sources, minus matched removals, with its insertions, so
+// columns stay sorted and no global sort is needed. Returns 0, leaving g
+// unchanged, when a removal names an edge that is not in the graph.
+static int applyEdgeBatch(Graph *g, EdgeBatch *batch)
+{
+    int n = g->n, v;
+    int removals = 0, insertions = 0;
+    for (int i = 0; i < batch->count; i++)
+    {
+        removals += batch->remove[i];
+    }
+    insertions = batch->count - removals;
+
+    // Both lists hold (target, source) pairs sorted the same way as the columns,
+    // which buildGraph and convert_graph both sort by source.
+    int *removed = (int *)malloc((removals > 0 ? removals : 1) * 2 * sizeof(int));
+    int *inserted = (int *)malloc((insertions > 0 ? insertions : 1) * 2 * sizeof(int));
+    for (int i = 0, r = 0, a = 0; i < batch->count; i++)
+    {
+        int *pair = batch->remove[i] ? &removed[2 * r++] : &inserted[2 * a++];
+        pair[0] = batch->dst[i];
+        pair[1] = batch->src[i];
+    }
+    qsort(removed, removals, 2 * sizeof(int), compareEdges);
+    qsort(inserted, insertions, 2 * sizeof(int), compareEdges);
+
+    int edges = g->edges - removals + insertions;
+    int *outLinks = (int *)malloc(n * sizeof(int));
+    int *inOffsets = (int *)malloc((n + 1) * sizeof(int));
+    int *inSources = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+    memcpy(outLinks, g->outLinks, n * sizeof(int));
+
+    #pragma omp parallel for shared(g, inOffsets) private(v)
+    for (v = 0; v < n; v++)
+    {
+        inOffsets[v + 1] = g->inOffsets[v + 1] - g->inOffsets[v];
+    }
+    for (int i = 0; i < removals; i++)
+    {
+        inOffsets[removed[2 * i] + 1]--;
+        outLinks[removed[2 * i + 1]]--;
+    }
+    for (int i = 0; i < insertions; i++)
+    {
+        inOffsets[inserted[2 * i] + 1]++;
+        outLinks[inserted[2 * i + 1]]++;
+    }
+
+    int missing = 0;
+    for (v = 0; v < n && !missing; v++)
+    {
+        missing = inOffsets[v + 1] < 0;
+    }
+    if (!missing)
+    {
+        prefixSum(inOffsets, n);
+
+        #pragma omp parallel for shared(g, inOffsets, inSources, removed, inserted, missing) private(v) schedule(dynamic, 1024)
+        for (v = 0; v < n; v++)
+        {
+            int r = lowerBoundEdge(removed, removals, v, 0);
+            int a = lowerBoundEdge(inserted, insertions, v, 0);
+            int e = g->inOffsets[v], out = inOffsets[v];
+            while (e < g->inOffsets[v + 1] || (a < insertions && inserted[2 * a] == v))
+            {
+                int u = e < g->inOffsets[v + 1] ? g->inSources[e] : -1;
+                if (u >= 0 && r < removals && removed[2 * r] == v && removed[2 * r + 1] == u)
+                {
+                    r++;
+                    e++;
+                    continue;
+                }
+                if (a < insertions && inserted[2 * a] == v && (u < 0 || inserted[2 * a + 1] < u))
+                {
+                    inSources[out++] = inserted[2 * a++ + 1];
+                    continue;
+                }
+                if (out == inOffsets[v + 1])
+                {
+                    break;
+                }
+                inSources[out++] = u;
+                e++;
+            }
+            if (out != inOffsets[v + 1] || (r < removals && removed[2 * r] == v))
+            {
+                #pragma omp atomic write
+                missing = 1;
+            }
+        }
+    }
+
+    free(removed);
+    free(inserted);
+    if (missing)
+    {
+        printf("Error: Edge update removes an edge that is not in the graph.\n");
+        free(outLinks);
+        free(inOffsets);
+        free(inSources);
+        return 0;
+    }
+
+    if (g->outOffsets)
+    {
+        applyEdgeBatchToOutEdges(g, batch, outLinks, edges);
+    }
+    if (g->mapping)
+    {
+        munmap(g->mapping, g->mappingSize);
+        g->mapping = NULL;
+        g->mappingSize = 0;
+    }
+    else
+    {
+        free(g->outLinks);
+        free(g->inOffsets);
+        free(g->inSources);
+    }
+    g->edges = edges;
+    g->outLinks = outLinks;
+    g->inOffsets = inOffsets;
+    g->inSources = inSources;
+    return 1;
+}
+
+// Applies the batch to g and repairs ranks, the converged ranks of the graph
+// before the update, in place. The old ranks are rescaled to the unnormalized
+// push solution (by (1 - d) / (1 - d + d * dangling mass)), the residual is
+// computed only at vertices whose in-links or in-neighbours' out-degrees
+// changed, and only those residuals are pushed. Returns the push work, or
+// iterations = -1 if the batch could not be applied. The update never resumes
+// from or writes checkpoints.
+Stats updatePageRankIncremental(Graph *g, EdgeBatch *batch, const Options *options, double *ranks)
+{
+    omp_set_num_threads(options->threads);
+    int n = g->n, i;
+    Stats stats = {-1, 0, 0.0};
+    Options push = *options;
+    push.startIteration = 0;
+    push.checkpointFile = NULL;
+
+    // The scale depends on the dangling set before the update.
+    double *x = (double *)malloc(n * sizeof(double));
+    scaleRanksForPush(g, ranks, x, options->damping);
+
+    int *oldOutLinks = (int *)malloc(n * sizeof(int));
+    memcpy(oldOutLinks, g->outLinks, n * sizeof(int));
+    if (!applyEdgeBatch(g, batch))
+    {
+        free(oldOutLinks);
+        free(x);
+        return stats;
+    }
+    buildOutEdges(g);
+
+    double *residual = (double *)calloc(n, sizeof(double));
+    char *affected = (char *)calloc(n, 1);
+
+    // Targets of changed edges, plus every out-neighbour of a source whose
+    // out-degree changed (removed targets are covered by the first case).
+    for (i = 0; i < batch->count; i++)
+    {
+        int u = batch->src[i];
+        affected[batch->dst[i]] = 1;
+        if (g->outLinks[u] != oldOutLinks[u])
+        {
+            for (int e = g->outOffsets[u]; e < g->outOffsets[u + 1]; e++)
+            {
+                affected[g->outTargets[e]] = 1;
+            }
+        }
+    }
+
+    computeResiduals(g, x, residual, affected, options->damping, options->teleport);
+    stats = pushResiduals(g, x, residual, &push);
+    stats.residual /= normalizeRanks(n, x, ranks);
+
+    free(oldOutLinks);
+    free(x);
+    free(residual);
+    free(affected);
+    return stats;
+}
+
+#if PAGERANK_PROFILE
+// Counter readings at the last phase boundary.
+static double lastEvents[COUNTER_COUNT];
+static double lastBytes;
+
+static void readProfileCounters(double *events, double *bytes)
+{
+    memset(events, 0, COUNTER_COUNT * sizeof(double));
+    *bytes = 0.0;
+    if (activeProfile->counters)
+    {
+        readPerfCounters(activeProfile->counters, events);
+    }
+    if (activeProfile->bandwidth)
+    {
+        double *socketBytes = (double *)calloc(activeProfile->bandwidth->sockets, sizeof(double));
+        readBandwidthCounters(activeProfile->bandwidth, socketBytes);
+        for (int k = 0; k < activeProfile->bandwidth->sockets; k++)
+        {
+            *bytes += socketBytes[k];
+        }
+        free(socketBytes);
+    }
+}
+
+static void chargePhase(Phase phase, double *t)
+{
+    double now = omp_get_wtime();
+    activeProfile->phaseTime[phase] += now - *t;
+    *t = now;
+    if (activeProfile->counters || activeProfile->bandwidth)
+    {
+        double events[COUNTER_COUNT], bytes;
+        readProfileCounters(events, &bytes);
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            activeProfile->phaseEvents[phase][c] += events[c] - lastEvents[c];
+            lastEvents[c] = events[c];
+        }
+        activeProfile->phaseBytes[phase] += bytes - lastBytes;
+        lastBytes = bytes;
+    }
+}
+#endif
+
+// Makes options->profile, if any, the profile of the solve starting now,
+// with room for the iterations it may run.
+static void startProfile(const Options *options)
+{
+#if PAGERANK_PROFILE
+    Profile *profile = options->profile;
+    activeProfile = profile;
+    if (!profile)
+    {
+        return;
+    }
+    int capacity = options->maxIterations - options->startIteration;
+    freeProfile(profile);
+    memset(profile->phaseTime, 0, sizeof(profile->phaseTime));
+    memset(profile->phaseEvents, 0, sizeof(profile->phaseEvents));
+    memset(profile->phaseBytes, 0, sizeof(profile->phaseBytes));
+    if (profile->counters || profile->bandwidth)
+    {
+        readProfileCounters(lastEvents, &lastBytes);
+    }
+    profile->threads = options->threads;
+    profile->busy = (double *)calloc(options->threads, sizeof(double));
+    profile->idle = (double *)calloc(options->threads, sizeof(double));
+    profile->residualL1 = (double *)malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+    profile->residualMax = (double *)malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+#else
+    (void)options;
+#endif
+}
+
+// Charges each thread's share of the update phase that it was not busy as
+// idle, and ends the profiled solve.
+static void finishProfile(void)
+{
+#if PAGERANK_PROFILE
+    Profile *profile = activeProfile;
+    activeProfile = NULL;
+    if (!profile)
+    {
+        return;
+    }
+    double busy = 0.0;
+    for (int t = 0; t < profile->threads; t++)
+    {
+        busy += profile->busy[t];
+    }
+    for (int t = 0; t < profile->threads && busy > 0.0; t++)
+    {
+        profile->idle[t] = fmax(profile->phaseTime[PHASE_UPDATE] - profile->busy[t], 0.0);
+    }
+#endif
+}
+
+// Solves with the chosen engine, starting from options->startRanks if given,
+// and returns the iterations run and links visited. options->maxIterations
+// caps the total including options->startIteration. When ranks is not NULL it
+// receives the latest rank vector; with a checkpoint file it is also saved
+// there.
+Stats computePageRank(Graph *g, const Options *options, double *ranks)
+{
+    int maxIterations = options->maxIterations, threads = options->threads;
+    omp_set_num_threads(threads);
+    double *opg = (double *)malloc(g->n * sizeof(double));
+    double *npg = (double *)malloc(g->n * sizeof(double));
+    double *invOutLinks = NULL;
+    rank_t *contrib = NULL;
+    accum_t *partial = NULL;
+    Partition *part = NULL;
+    Segments *seg = NULL;
+    Engine engine = options->engine;
+    Stats stats = {options->startIteration, 0, 0.0};
+    int interval = options->checkpointFile ? options->checkpointInterval : 0;
+    TopSelection *sel = NULL;
+    int i;
+
+    startProfile(options);
+    PROFILE_START(phase);
+    selectPinning(options->pinning);
+    pinThreads();
+    if (engine != ENGINE_BASELINE)
+    {
+        selectKernel(options->kernel);
+    }
+    if (engine == ENGINE_PULL || engine == ENGINE_FUSED || engine == ENGINE_GAUSS_SEIDEL)
+    {
+        part = buildPartition(g, options->schedule, options->splitHeavy, threads);
+        applySchedule(options->schedule);
+        if (options->localGraph)
+        {
+            localizeGraph(g, part);
+        }
+        firstTouch(part, opg, sizeof(double));
+        firstTouch(part, npg, sizeof(double));
+    }
+    if (options->startRanks)
+    {
+        memcpy(opg, options->startRanks, g->n * sizeof(double));
+    }
+    else
+    {
+        initializePageRank(g, opg);
+    }
+    if (engine != ENGINE_BASELINE && engine != ENGINE_PUSH)
+    {
+        invOutLinks = (double *)malloc(g->n * sizeof(double));
+        if (part)
+        {
+            firstTouch(part, invOutLinks, sizeof(double));
+        }
+        computeInverseOutLinks(g, invOutLinks, options->damping);
+    }
+    if (engine == ENGINE_PULL)
+    {
+        contrib = (rank_t *)malloc(g->n * sizeof(rank_t));
+        firstTouch(part, contrib, sizeof(rank_t));
+        partial = (accum_t *)malloc(part->count * sizeof(accum_t));
+    }
+    if (engine == ENGINE_BLOCKED)
+    {
+        seg = buildSegments(g, options->segmentBytes);
+        contrib = (rank_t *)malloc(g->n * sizeof(rank_t));
+        partial = (accum_t *)malloc((seg->entryStart[seg->count] > 0 ? seg->entryStart[seg->count] : 1) * sizeof(accum_t));
+    }
+    if (options->topK > 0 && (engine == ENGINE_BASELINE || engine == ENGINE_PULL || engine == ENGINE_BLOCKED))
+    {
+        sel = createTopSelection(g->n, options->topK, threads);
+    }
+    PROFILE_PHASE(PHASE_SETUP, phase);
+    if (engine == ENGINE_PUSH)
+    {
+        stats = computePageRankPush(g, opg, options);
+        maxIterations = 0;
+    }
+    else if (engine == ENGINE_FUSED || engine == ENGINE_GAUSS_SEIDEL)
+    {
+        stats = computePageRankFused(g, part, opg, invOutLinks, options);
+        maxIterations = 0;
+    }
+
+    while (stats.iterations < maxIterations)
+    {
+        PROFILE_RESTART(phase);
+        if (engine == ENGINE_PULL)
+        {
+            double dp = computeContributions(g, invOutLinks, opg, contrib, options->damping);
+            PROFILE_PHASE(PHASE_DANGLING, phase);
+            updatePageRankPull(g, part, partial, contrib, npg, dp, options->damping, options->teleport);
+        }
+        else if (engine == ENGINE_BLOCKED)
+        {
+            double dp = computeContributions(g, invOutLinks, opg, contrib, options->damping);
+            PROFILE_PHASE(PHASE_DANGLING, phase);
+            updatePageRankBlocked(g, seg, partial, contrib, npg, dp, options->damping, options->teleport);
+        }
+        else
+        {
+            double dp = computeDanglingContribution(g, opg, options->damping);
+            PROFILE_PHASE(PHASE_DANGLING, phase);
+            updatePageRank(g, opg, npg, dp, options->damping, options->teleport);
+        }
+        PROFILE_PHASE(PHASE_UPDATE, phase);
+        stats.iterations++;
+        stats.edgeTraversals += g->edges;
+        Norm norm = options->norm;
+        double residual = 0.0, l1 = 0.0, relative = 0.0;
+
+        // Parallel copying of npg to opg for the next iteration, measuring
+        // the change on the way; this also leaves the converged ranks in opg.
+        #pragma omp parallel for shared(opg, npg, norm) private(i) reduction(max : residual, relative) reduction(+ : l1)
+        for (i = 0; i < g->n; i++)
+        {
+            double change = fabs(npg[i] - opg[i]);
+            residual = fmax(residual, change);
+            l1 += change;
+            if (norm == NORM_RELATIVE)
+            {
+                relative = fmax(relative, relativeChange(change, npg[i]));
+            }
+            opg[i] = npg[i];
+        }
+        stats.residual = normOf(norm, residual, l1, relative);
+        PROFILE_PHASE(PHASE_COPY, phase);
+        PROFILE_TRACE(l1, residual);
+
+        // Converged, or the top k are settled.
+        int converged = 0;
+        if (stats.iterations % options->checkInterval == 0)
+        {
+            converged = stats.residual <= options->tolerance;
+            if (!converged && sel && stats.iterations < maxIterations)
+            {
+                #pragma omp parallel shared(sel, opg)
+                selectTop(sel, opg, g->n);
+                converged = topSettled(sel, opg, topBound(options->damping, l1));
+            }
+        }
+        PROFILE_PHASE(PHASE_CONVERGENCE, phase);
+        if (converged)
+        {
+            break;
+        }
+
+        // The final ranks are saved below.
+        if (interval > 0 && stats.iterations % interval == 0 && stats.iterations < maxIterations)
+        {
+            saveCheckpoint(g, options->checkpointFile, opg, stats.iterations, stats.residual);
+        }
+    }
+
+    // printf("PageRank values:\n");
+    // for (int i = 0; i < g->n; i++)
+    // {
+    //     printf("Node %d: %.6f\n", i, opg[i]);
+    // }
+
+    if (ranks)
+    {
+        memcpy(ranks, opg, g->n * sizeof(double));
+    }
+    if (options->checkpointFile)
+    {
+        saveCheckpoint(g, options->checkpointFile, opg, stats.iterations, stats.residual);
+    }
+
+    free(opg);
+    free(npg);
+    free(contrib);
+    free(invOutLinks);
+    free(partial);
+    if (part)
+    {
+        freePartition(part);
+    }
+    if (seg)
+    {
+        freeSegments(seg);
+    }
+    if (sel)
+    {
+        freeTopSelection(sel);
+    }
+    finishProfile();
+    return stats;
+}
+
+// Solves the k personalized problems of teleports together with the pull
+// formulation: each iteration computes the n x k contributions and the k
+// dangling sums, then gathers every in-link's k contributions with one
+// vectorizable row add. options->engine, splitHeavy, kernel, startRanks,
+// checkpointFile, profile, teleport and topK are not used. The solve stops
+// when the change of every column, in options->norm, is at most the
+// tolerance; iterations is -1 if k is not positive.
+Stats computePageRankBatch(Graph *g, const Options *options, int k, const double *teleports, double *ranks)
+{
+    int n = g->n, b, p, j;
+    size_t row = (size_t)k;
+    double damping = options->damping;
+    Stats stats = {-1, 0, 0.0};
+    if (k < 1)
+    {
+        printf("Error: Invalid batch size.\n");
+        return stats;
+    }
+
+    omp_set_num_threads(options->threads);
+    selectPinning(options->pinning);
+    pinThreads();
+    Partition *part = buildPartition(g, options->schedule, 0, options->threads);
+    applySchedule(options->schedule);
+    double *x = (double *)malloc(n * row * sizeof(double));
+    double *next = (double *)malloc(n * row * sizeof(double));
+    rank_t *contrib = (rank_t *)malloc(n * row * sizeof(rank_t));
+    double *dangling = (double *)malloc(row * sizeof(double));
+    double *share = (double *)malloc(row * sizeof(double));
+    double *l1 = (double *)malloc(row * sizeof(double));
+    Norm norm = options->norm;
+    firstTouch(part, x, row * sizeof(double));
+    firstTouch(part, next, row * sizeof(double));
+    firstTouch(part, contrib, row * sizeof(rank_t));
+
+    #pragma omp parallel for schedule(runtime) shared(part, x) private(b, p, j)
+    for (b = 0; b < part->count; b++)
+    {
+        for (p = part->blocks[b].begin; p < part->blocks[b].end; p++)
+        {
+            for (j = 0; j < k; j++)
+            {
+                x[p * row + j] = 1.0 / n;
+            }
+        }
+    }
+
+    stats.iterations = 0;
+    int converged = 0;
+    while (!converged && stats.iterations < options->maxIterations)
+    {
+        double residual = 0.0, relative = 0.0;
+        memset(dangling, 0, row * sizeof(double));
+        memset(l1, 0, row * sizeof(double));
+
+        #pragma omp parallel for schedule(runtime) shared(g, part, x, contrib, damping) private(b, p, j) reduction(+ : dangling[:k])
+        for (b = 0; b < part->count; b++)
+        {
+            for (p = part->blocks[b].begin; p < part->blocks[b].end; p++)
+            {
+                const double *xp = x + p * row;
+                rank_t *cp = contrib + p * row;
+                double scale = g->outLinks[p] ? damping / g->outLinks[p] : 0.0;
+                #pragma omp simd
+                for (j = 0; j < k; j++)
+                {
+                    cp[j] = (rank_t)(xp[j] * scale);
+                }
+                if (g->outLinks[p] == 0)
+                {
+                    for (j = 0; j < k; j++)
+                    {
+                        dangling[j] += xp[j];
+                    }
+                }
+            }
+        }
+        for (j = 0; j < k; j++)
+        {
+            share[j] = 1.0 - damping + damping * dangling[j];
+        }
+
+        #pragma omp parallel shared(g, part, x, next, contrib, teleports, share, norm) private(b, p, j) reduction(max : residual, relative) reduction(+ : l1[:k])
+        {
+            accum_t *sum = (accum_t *)malloc(row * sizeof(accum_t));
+            #pragma omp for schedule(runtime)
+            for (b = 0; b < part->count; b++)
+            {
+                for (p = part->blocks[b].begin; p < part->blocks[b].end; p++)
+                {
+                    for (j = 0; j < k; j++)
+                    {
+                        sum[j] = 0.0;
+                    }
+                    for (int e = g->inOffsets[p]; e < g->inOffsets[p + 1]; e++)
+                    {
+                        const rank_t *c = contrib + (size_t)g->inSources[e] * row;
+                        #pragma omp simd
+                        for (j = 0; j < k; j++)
+                        {
+                            sum[j] += c[j];
+                        }
+                    }
+                    const double *t = teleports + p * row, *xp = x + p * row;
+                    double *np = next + p * row;
+                    for (j = 0; j < k; j++)
+                    {
+                        np[j] = share[j] * t[j] + sum[j];
+                        double change = fabs(np[j] - xp[j]);
+                        residual = fmax(residual, change);
+                        l1[j] += change;
+                        if (norm == NORM_RELATIVE)
+                        {
+                            relative = fmax(relative, relativeChange(change, np[j]));
+                        }
+                    }
+                }
+            }
+            free(sum);
+        }
+
+        double *swap = x;
+        x = next;
+        next = swap;
+        stats.iterations++;
+        stats.edgeTraversals += g->edges;
+        double l1Max = 0.0;
+        for (j = 0; j < k; j++)
+        {
+            l1Max = fmax(l1Max, l1[j]);
+        }
+        stats.residual = normOf(norm, residual, l1Max, relative);
+        converged = stats.iterations % options->checkInterval == 0 && stats.residual <= options->tolerance;
+    }
+
+    memcpy(ranks, x, n * row * sizeof(double));
+    free(x);
+    free(next);
+    free(contrib);
+    free(dangling);
+    free(share);
+    free(l1);
+    freePartition(part);
+    return stats;
+}
+
+// Reads one seed set per line as whitespace-separated input vertex IDs,
+// skipping blank lines, and maps them to g's vertex order.
+SeedSets *readSeedSets(Graph *g, const char *filename)
+{
+    int n = g->n;
+    FILE *file = fopen(filename, "r");
+    if (!file)
+    {
+        printf("Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+
+    SeedSets *sets = (SeedSets *)malloc(sizeof(SeedSets));
+    int setCapacity = 64, capacity = 1024, size = 0, valid = 1;
+    sets->count = 0;
+    sets->offsets = (int *)malloc((setCapacity + 1) * sizeof(int));
+    sets->vertices = (int *)malloc(capacity * sizeof(int));
+    sets->offsets[0] = 0;
+
+    char *line = NULL;
+    size_t lineSize = 0;
+    while (valid && getline(&line, &lineSize, file) != -1)
+    {
+        char *c = line, *end;
+        int members = 0;
+        while (1)
+        {
+            long v = strtol(c, &end, 10);
+            if (end == c)
+            {
+                break;
+            }
+            if (v < 0 || v >= n)
+            {
+                valid = 0;
+                break;
+            }
+            if (size == capacity)
+            {
+                capacity *= 2;
+                sets->vertices = (int *)realloc(sets->vertices, capacity * sizeof(int));
+            }
+            sets->vertices[size++] = (int)v;
+            members++;
+            c = end;
+        }
+        while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+        {
+            c++;
+        }
+        valid = valid && *c == '\0';
+        if (valid && members > 0)
+        {
+            if (sets->count == setCapacity)
+            {
+                setCapacity *= 2;
+                sets->offsets = (int *)realloc(sets->offsets, (setCapacity + 1) * sizeof(int));
+            }
+            sets->offsets[++sets->count] = size;
+        }
+    }
+    free(line);
+    fclose(file);
+    if (!valid || sets->count == 0)
+    {
+        printf("Error: Invalid seed set or out-of-bounds node.\n");
+        freeSeedSets(sets);
+        return NULL;
+    }
+
+    if (g->originalIds)
+    {
+        int *newIds = (int *)malloc(n * sizeof(int));
+        int i;
+        #pragma omp parallel for shared(g, newIds) private(i)
+        for (i = 0; i < n; i++)
+        {
+            newIds[g->originalIds[i]] = i;
+        }
+        for (i = 0; i < size; i++)
+        {
+            sets->vertices[i] = newIds[sets->vertices[i]];
+        }
+        free(newIds);
+    }
+    return sets;
+}
+
+void freeSeedSets(SeedSets *sets)
+{
+    free(sets->offsets);
+    free(sets->vertices);
+    free(sets);
+}
+
+// Column j of teleports becomes the uniform distribution over set first + j.
+void seedTeleports(Graph *g, const SeedSets *sets, int first, int k, double *teleports)
+{
+    memset(teleports, 0, (size_t)g->n * k * sizeof(double));
+    for (int j = 0; j < k; j++)
+    {
+        int begin = sets->offsets[first + j], end = sets->offsets[first + j + 1];
+        for (int i = begin; i < end; i++)
+        {
+            teleports[(size_t)sets->vertices[i] * k + j] += 1.0 / (end - begin);
+        }
+    }
+}
+
+void initOptions(Options *options)
+{
+    memset(options, 0, sizeof(Options));
+    options->engine = ENGINE_BASELINE;
+    options->damping = DAMPING_FACTOR;
+    options->tolerance = THRESHOLD;
+    options->norm = NORM_LINF;
+    options->checkInterval = 1;
+    options->maxIterations = MAX_ITERATIONS;
+    options->threads = omp_get_max_threads();
+    options->schedule = SCHEDULE_VERTICES;
+    options->kernel = KERNEL_AUTO;
+    options->pinning = PIN_NONE;
+}
+
+// Whether the n values of v are non-negative and sum to 1.
+static int isDistribution(const double *v, int n)
+{
+    double total = 0.0;
+    int negative = 0, i;
+    #pragma omp parallel for shared(v) private(i) reduction(+ : total) reduction(|| : negative)
+    for (i = 0; i < n; i++)
+    {
+        total += v[i];
+        negative = negative || !(v[i] >= 0.0);
+    }
+    return !negative && fabs(total - 1.0) <= 1e-9 * n;
+}
+
+// Checks options, solves g and returns the ranks in input vertex IDs with the
+// stats and wall time of the solve, or NULL if the options are invalid.
+PageRankResult *solvePageRank(Graph *g, const Options *options)
+{
+    if (!(options->damping >= 0.0 && options->damping < 1.0) || !(options->tolerance >= 0.0) ||
+        options->norm < NORM_LINF || options->norm > NORM_RELATIVE || options->checkInterval < 1 ||
+        options->maxIterations < 0 || options->threads < 1 ||
+        options->startIteration < 0 || options->startIteration > options->maxIterations || options->topK < 0 ||
+        (options->teleport && !isDistribution(options->teleport, g->n)))
+    {
+        printf("Error: Invalid solver options.\n");
+        return NULL;
+    }
+
+    PageRankResult *result = (PageRankResult *)malloc(sizeof(PageRankResult));
+    double *ranks = (double *)malloc(g->n * sizeof(double));
+    double start_time = omp_get_wtime();
+    result->stats = computePageRank(g, options, ranks);
+    result->time = omp_get_wtime() - start_time;
+    result->n = g->n;
+    if (g->originalIds)
+    {
+        result->ranks = (double *)malloc(g->n * sizeof(double));
+        toInputOrder(g, ranks, result->ranks);
+        free(ranks);
+    }
+    else
+    {
+        result->ranks = ranks;
+    }
+    return result;
+}
+
+void freePageRankResult(PageRankResult *result)
+{
+    free(result->ranks);
+    free(result);
+}
+
+void printProfile(const Profile *profile)
+{
+    if (!PAGERANK_PROFILE || profile->threads == 0)
+    {
+        printf("No profile recorded; build the library with -DPAGERANK_PROFILE=1\n");
+        return;
+    }
+    printf("Phase times:");
+    for (int phase = 0; phase < PHASE_COUNT; phase++)
+    {
+        printf("%s %s = %f s", phase ? "," : "", phaseNames[phase], profile->phaseTime[phase]);
+    }
+    printf("\n");
+    for (int phase = 0; phase < PHASE_COUNT && (profile->counters || profile->bandwidth); phase++)
+    {
+        const char *separator = "";
+        printf("Phase %s:", phaseNames[phase]);
+        for (int c = 0; c < COUNTER_COUNT; c++)
+        {
+            if (profile->counters && profile->counters->available[c])
+            {
+                printf("%s %s = %.0f", separator, counterNames[c], profile->phaseEvents[phase][c]);
+                separator = ",";
+            }
+        }
+        if (profile->bandwidth && profile->phaseTime[phase] > 0.0)
+        {
+            printf("%s memory = %f GB/s", separator, profile->phaseBytes[phase] / profile->phaseTime[phase] / 1e9);
+        }
+        printf("\n");
+    }
+
+    double maxBusy = 0.0, totalBusy = 0.0;
+    for (int t = 0; t < profile->threads; t++)
+    {
+        maxBusy = fmax(maxBusy, profile->busy[t]);
+        totalBusy += profile->busy[t];
+    }
+    if (totalBusy > 0.0)
+    {
+        for (int t = 0; t < profile->threads; t++)
+        {
+            printf("Thread %d: busy = %f s, idle = %f s\n", t, profile->busy[t], profile->idle[t]);
+        }
+        printf("Load imbalance (max / mean busy time) = %f\n", maxBusy * profile->threads / totalBusy);
+    }
+    for (int i = 0; i < profile->traceLength; i++)
+    {
+        printf("Iteration %d: L1 = %e, max = %e\n", i + 1, profile->residualL1[i], profile->residualMax[i]);
+    }
+}
+
+// Frees the profile's arrays; the profile itself, and any counters attached
+// to it, belong to the caller.
+void freeProfile(Profile *profile)
+{
+    free(profile->busy);
+    free(profile->idle);
+    free(profile->residualL1);
+    free(profile->residualMax);
+    profile->busy = profile->idle = NULL;
+    profile->residualL1 = profile->residualMax = NULL;
+    profile->threads = 0;
+    profile->traceLength = 0;
+}
+
+int parseName(const char *name, const char *const names[], int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Applies one of the getopt options in SOLVER_OPTIONS to options. Returns 1
+// if opt is one of them, 0 if it is not and -1 if its argument is invalid.
+int parseSolverOption(Options *options, int opt, const char *arg)
+{
+    int index;
+    switch (opt)
+    {
+    case 's':
+        index = parseName(arg, scheduleNames, sizeof(scheduleNames) / sizeof(scheduleNames[0]));
+        if (index < 0)
+        {
+            return -1;
+        }
+        options->schedule = (Schedule)index;
+        return 1;
+    case 'H':
+        options->splitHeavy = 1;
+        return 1;
+    case 'k':
+        index = parseName(arg, kernelNames, sizeof(kernelNames) / sizeof(kernelNames[0]));
+        if (index < 0)
+        {
+            return -1;
+        }
+        options->kernel = (Kernel)index;
+        return 1;
+    case 'b':
+        options->segmentBytes = atol(arg) * 1024;
+        return options->segmentBytes > 0 ? 1 : -1;
+    case 'N':
+        options->localGraph = 1;
+        return 1;
+    case 'T':
+        options->topK = atoi(arg);
+        return options->topK > 0 ? 1 : -1;
+    case 'd':
+        options->damping = atof(arg);
+        return options->damping >= 0.0 && options->damping < 1.0 ? 1 : -1;
+    case 'x':
+        options->tolerance = atof(arg);
+        return options->tolerance >= 0.0 ? 1 : -1;
+    case 'm':
+        index = parseName(arg, normNames, sizeof(normNames) / sizeof(normNames[0]));
+        if (index < 0)
+        {
+            return -1;
+        }
+        options->norm = (Norm)index;
+        return 1;
+    case 'I':
+        options->checkInterval = atoi(arg);
+        return options->checkInterval > 0 ? 1 : -1;
+    case 'p':
+        index = parseName(arg, pinningNames, sizeof(pinningNames) / sizeof(pinningNames[0]));
+        if (index < 0)
+        {
+            return -1;
+        }
+        options->pinning = (Pinning)index;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void printSolverOptions(void)
+{
+    printf("  -d  damping factor (default %g)\n", DAMPING_FACTOR);
+    printf("  -x  convergence tolerance (default %g)\n", THRESHOLD);
+    printf("  -m  norm of the change the tolerance applies to:");
+    for (int i = 0; i < (int)(sizeof(normNames) / sizeof(normNames[0])); i++)
+    {
+        printf(" %s", normNames[i]);
+    }
+    printf(" (default %s)\n", normNames[NORM_LINF]);
+    printf("  -I  test for convergence every this many iterations (default 1)\n");
+    printf("  -s  schedule for pull and fused:");
+    for (int i = 0; i < (int)(sizeof(scheduleNames) / sizeof(scheduleNames[0])); i++)
+    {
+        printf(" %s", scheduleNames[i]);
+    }
+    printf(" (default %s)\n  -H  split vertices with more in-links than a block's share\n", scheduleNames[SCHEDULE_VERTICES]);
+    printf("  -k  gather kernel for pull and fused:");
+    for (int i = 0; i < (int)(sizeof(kernelNames) / sizeof(kernelNames[0])); i++)
+    {
+        printf(" %s", kernelNames[i]);
+    }
+    printf(" (default %s)\n", kernelNames[KERNEL_AUTO]);
+    printf("  -N  copy the graph so each thread's columns are local to its socket (pull and fused)\n");
+    printf("  -p  pin threads to CPUs:");
+    for (int i = 0; i < (int)(sizeof(pinningNames) / sizeof(pinningNames[0])); i++)
+    {
+        printf(" %s", pinningNames[i]);
+    }
+    printf(" (default %s)\n", pinningNames[PIN_NONE]);
+    printf("  -b  contributions per segment for blocked, in KiB (default half the L2 cache)\n");
+    printf("  -T  stop once the k highest ranks and their order can no longer change\n");
+    printf("      (baseline, pull, fused and blocked)\n");
+}
+
@@ -0,0 +1,361 @@
+#ifndef PAGERANK_H
+#define PAGERANK_H
+
+#include <stddef.h>
+
+// PageRank solver library: graph loading and construction, the engines, and
+// checkpoints and incremental updates of rank vectors. Build it with
+//   gcc -O2 -fopenmp -c pagerank.c
+// and link with -fopenmp -lm. Functions report errors on stdout and return
+// NULL (or 0) on failure.
+
+// Defaults filled in by initOptions.
+#define DAMPING_FACTOR 0.85
+#define THRESHOLD 0.0001
+#define MAX_ITERATIONS 100
+
+// Storage precision of the contributions gathered by the pull and fused
+// engines and of the fused engine's rank vectors, chosen at compile time with
+// -DRANK_PRECISION=<n>, which the library and its callers must agree on.
+// Mixed stores floats and accumulates each vertex's sum in double. The
+// baseline engine always works in double.
+#define PRECISION_DOUBLE 0
+#define PRECISION_MIXED 1
+#define PRECISION_FLOAT 2
+
+#ifndef RANK_PRECISION
+#define RANK_PRECISION PRECISION_DOUBLE
+#endif
+
+static const char *const precisionNames[] = {"double", "mixed", "float"};
+
+typedef enum
+{
+    ENGINE_BASELINE,
+    ENGINE_PULL,
+    ENGINE_FUSED,
+    ENGINE_GAUSS_SEIDEL,
+    ENGINE_PUSH,
+    ENGINE_BLOCKED
+} Engine;
+
+static const char *const engineNames[] = {"baseline", "pull", "fused", "gauss-seidel", "push", "blocked"};
+
+// How the pull and fused engines divide vertices between threads.
+typedef enum
+{
+    SCHEDULE_VERTICES,
+    SCHEDULE_EDGES,
+    SCHEDULE_DYNAMIC,
+    SCHEDULE_GUIDED
+} Schedule;
+
+static const char *const scheduleNames[] = {"vertices", "edges", "dynamic", "guided"};
+
+// Gather-sum kernel used by the pull and fused engines. KERNEL_AUTO picks the
+// widest one the CPU supports at run time.
+typedef enum
+{
+    KERNEL_AUTO,
+    KERNEL_SCALAR,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+} Kernel;
+
+static const char *const kernelNames[] = {"auto", "scalar", "avx2", "avx512"};
+
+// How solver threads are pinned to CPUs: packed socket by socket, or dealt
+// round-robin across the sockets.
+typedef enum
+{
+    PIN_NONE,
+    PIN_COMPACT,
+    PIN_SCATTER
+} Pinning;
+
+static const char *const pinningNames[] = {"none", "compact", "scatter"};
+
+// How the change in the ranks over an iteration is measured for the
+// convergence test: the largest change, the sum of the changes, or the
+// largest change relative to the new rank.
+typedef enum
+{
+    NORM_LINF,
+    NORM_L1,
+    NORM_RELATIVE
+} Norm;
+
+static const char *const normNames[] = {"linf", "l1", "relative"};
+
+// Relabelling applied to the vertices after loading, so that the ranks
+// gathered together sit close together in memory.
+typedef enum
+{
+    ORDER_NONE,
+    ORDER_DEGREE,
+    ORDER_RCM,
+    ORDER_GORDER
+} Ordering;
+
+static const char *const orderingNames[] = {"none", "degree", "rcm", "gorder"};
+
+// Instrumentation of computePageRank, compiled in with -DPAGERANK_PROFILE=1.
+// Without it the timers compile away and profiles are left empty.
+#ifndef PAGERANK_PROFILE
+#define PAGERANK_PROFILE 0
+#endif
+
+// Memory-controller (uncore IMC) read and write counters, opened on one CPU
+// per socket. Counting all traffic on a socket needs perf_event_paranoid <= 0
+// or CAP_PERFMON; without them, or on CPUs without these PMUs, no counters
+// open and bandwidth is not reported.
+typedef struct
+{
+    int count;
+    int *fd;
+    int *socket;
+    double *bytesPerCount;
+    int sockets;
+} BandwidthCounters;
+
+// Hardware events counted by each solver thread. LLC misses are the
+// generic cache-miss event, last-level misses on most CPUs.
+typedef enum
+{
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,
+    COUNTER_COUNT
+} Counter;
+
+static const char *const counterNames[] = {"cycles", "instructions", "LLC misses"};
+
+// Per-thread hardware counters, fd[t * COUNTER_COUNT + c] counting event c on
+// thread t of an OpenMP team (-1 where it did not open). Counting a
+// process's own user-space events needs perf_event_paranoid <= 2; machines
+// without a CPU PMU, such as many VMs, open none.
+typedef struct
+{
+    int threads;
+    int *fd;
+    int available[COUNTER_COUNT];
+} PerfCounters;
+
+// Phases of an iteration: the dangling sum (with the contributions, for
+// pull and blocked), the gather sweep over the in-links (the whole round for
+// push), the convergence test and any top-k selection (with the
+// end-of-iteration swap for fused and gauss-seidel) and the copy of the new
+// ranks, which also measures their change. Setup covers everything before
+// the first iteration.
+typedef enum
+{
+    PHASE_SETUP,
+    PHASE_DANGLING,
+    PHASE_UPDATE,
+    PHASE_CONVERGENCE,
+    PHASE_COPY,
+    PHASE_COUNT
+} Phase;
+
+static const char *const phaseNames[] = {"setup", "dangling", "update", "convergence", "copy"};
+
+// Where a solve's time went. busy[t] is the time thread t spent on its share
+// of the gather sweeps and idle[t] the rest of the update phase, spent
+// waiting for the slowest thread (push sweeps are not split by thread).
+// residualL1[i] and residualMax[i] are the L1 and max norms of the change in
+// the ranks in the i-th iteration of this solve (for push, of the residuals
+// left after the i-th round). The arrays belong to the profile and are
+// replaced by every solve; freeProfile releases them. When the caller sets
+// counters or bandwidth, they are also read at every phase boundary and the
+// events and bytes in between charged to the phase.
+typedef struct
+{
+    double phaseTime[PHASE_COUNT];
+    PerfCounters *counters;
+    BandwidthCounters *bandwidth;
+    double phaseEvents[PHASE_COUNT][COUNTER_COUNT];
+    double phaseBytes[PHASE_COUNT];
+    int threads;
+    double *busy;
+    double *idle;
+    int traceLength;
+    double *residualL1;
+    double *residualMax;
+} Profile;
+
+// Solver configuration; initOptions sets every field to its default.
+typedef struct
+{
+    Engine engine;
+    // Each rank is (1 - damping) / n plus damping times what its in-links
+    // pass on. A solve stops when the change in an iteration, measured in
+    // norm, is at most tolerance (for push, when no residual exceeds
+    // tolerance / n), or after maxIterations. The test, and the topK test,
+    // only runs every checkInterval iterations.
+    double damping;
+    double tolerance;
+    Norm norm;
+    int checkInterval;
+    int maxIterations;
+    // OpenMP threads used by the solve.
+    int threads;
+    Schedule schedule;
+    int splitHeavy;
+    Kernel kernel;
+    Pinning pinning;
+    // Contribution bytes per segment for the blocked engine; 0 picks from
+    // the cache size.
+    long segmentBytes;
+    // Copy the graph so each thread's columns are first touched, and so
+    // placed, by the thread that gathers them.
+    int localGraph;
+    // Ranks to start from instead of 1 / n, indexed by g's vertices as
+    // readCheckpoint returns them, and the iterations already done to reach
+    // them (0 for a warm start).
+    const double *startRanks;
+    int startIteration;
+    // When set, the ranks are saved here every checkpointInterval iterations
+    // (never, if 0) and when the solve ends.
+    const char *checkpointFile;
+    int checkpointInterval;
+    // When set, and PAGERANK_PROFILE is on, computePageRank records where
+    // the time went here.
+    Profile *profile;
+    // Personalization: the teleport distribution, indexed like startRanks
+    // and summing to 1, or NULL for the uniform 1 / n. Dangling rank is
+    // redistributed the same way.
+    const double *teleport;
+    // When positive, the baseline, pull, fused and blocked engines also stop
+    // once the topK highest ranks and their order are settled: the change in
+    // the last iteration bounds how far every rank can still move, and each
+    // of the topK leads the next by more than that (up to the rounding of
+    // reduced precisions).
+    int topK;
+} Options;
+
+// What a solve did: iterations (rounds for push, including any resumed ones),
+// in-link/out-link visits, and the convergence residual of the last iteration
+// in options->norm (for push, the largest residual).
+typedef struct
+{
+    int iterations;
+    long long edgeTraversals;
+    double residual;
+} Stats;
+
+// In-links are stored in compressed-sparse-column form: the sources of the
+// edges pointing at vertex v are inSources[inOffsets[v] .. inOffsets[v + 1]).
+// Graphs loaded from a binary file point into the mapping instead of owning
+// their arrays. The out-links, needed only by the push engine, are built on
+// demand by buildOutEdges into outTargets[outOffsets[u] .. outOffsets[u + 1]).
+// After reorderGraph, vertex v was vertex originalIds[v] in the input; files
+// (checkpoints, edge updates) keep using the input IDs.
+typedef struct
+{
+    int n;
+    int edges;
+    int *outLinks;
+    int *inOffsets;
+    int *inSources;
+    int *outOffsets;
+    int *outTargets;
+    int *originalIds;
+    void *mapping;
+    size_t mappingSize;
+} Graph;
+
+// Seed sets for personalized PageRank: set i is the vertices
+// vertices[offsets[i] .. offsets[i + 1]), in g's vertex order.
+typedef struct
+{
+    int count;
+    int *offsets;
+    int *vertices;
+} SeedSets;
+
+// A batch of edge insertions and removals; remove[i] marks src[i] -> dst[i]
+// for removal (one copy, if the edge is repeated) instead of insertion.
+typedef struct
+{
+    int count;
+    int *src;
+    int *dst;
+    char *remove;
+} EdgeBatch;
+
+// Ranks of a solve indexed by input vertex ID (as loaded, before any
+// reordering), and what the solve did.
+typedef struct
+{
+    int n;
+    double *ranks;
+    Stats stats;
+    double time;
+} PageRankResult;
+
+// Graphs. buildGraph takes an edge list src[i] -> dst[i] with IDs in [0, n);
+// readGraph loads a text edge list or a binary CSR file by its contents, and
+// writeGraphBinary saves a graph in the binary format.
+Graph *buildGraph(int n, int edges, const int *src, const int *dst);
+Graph *readGraphFromFile(const char *filename);
+Graph *readGraphFromBinaryFile(const char *filename);
+int isBinaryGraphFile(const char *filename);
+int writeGraphBinary(Graph *g, const char *filename);
+Graph *readGraph(const char *filename);
+Graph *reorderGraph(Graph *g, Ordering ordering);
+void freeGraph(Graph *g);
+
+// Solving. computePageRank works in g's vertex order and leaves the ranks in
+// ranks (if not NULL); solvePageRank allocates a result in input vertex IDs.
+void initOptions(Options *options);
+Stats computePageRank(Graph *g, const Options *options, double *ranks);
+PageRankResult *solvePageRank(Graph *g, const Options *options);
+void freePageRankResult(PageRankResult *result);
+Kernel selectKernel(Kernel kernel);
+void printProfile(const Profile *profile);
+void freeProfile(Profile *profile);
+// The change from opg to npg in norm, the residual the solvers compare with
+// their tolerance.
+double rankChange(Norm norm, const double *opg, const double *npg, int n);
+// Writes the min(k, n) highest-ranked vertices to top, highest first and
+// ties to the lower ID, with a parallel partial selection.
+void selectTopRanks(const double *ranks, int n, int k, int *top);
+int segmentShiftFor(int n, long segmentBytes);
+
+// Checkpoints and edge updates, in input vertex IDs.
+int saveCheckpoint(Graph *g, const char *filename, const double *ranks, int iterations, double residual);
+double *readCheckpoint(Graph *g, const char *filename, int resume, int *iterations, double *residual);
+EdgeBatch *readEdgeBatch(Graph *g, const char *filename);
+void freeEdgeBatch(EdgeBatch *batch);
+Stats updatePageRankIncremental(Graph *g, EdgeBatch *batch, const Options *options, double *ranks);
+
+// Personalized PageRank for k teleport vectors at once. teleports and ranks
+// are n x k blocks in g's vertex order, row v holding vertex v's k values,
+// so each pass over the in-links serves all k. readSeedSets reads one set of
+// input vertex IDs per line; seedTeleports fills a block with the uniform
+// distributions over sets first .. first + k - 1.
+Stats computePageRankBatch(Graph *g, const Options *options, int k, const double *teleports, double *ranks);
+SeedSets *readSeedSets(Graph *g, const char *filename);
+void freeSeedSets(SeedSets *sets);
+void seedTeleports(Graph *g, const SeedSets *sets, int first, int k, double *teleports);
+
+// Command-line helpers shared by the programs. parseName returns the index
+// of name in names, or -1; parseSolverOption handles the getopt options in
+// SOLVER_OPTIONS and printSolverOptions describes them.
+#define SOLVER_OPTIONS "s:Hk:b:Np:T:d:x:m:I:"
+int parseName(const char *name, const char *const names[], int count);
+int parseSolverOption(Options *options, int opt, const char *arg);
+void printSolverOptions(void);
+
+BandwidthCounters *openBandwidthCounters(void);
+void readBandwidthCounters(BandwidthCounters *counters, double *bytes);
+void closeBandwidthCounters(BandwidthCounters *counters);
+
+// Opens the counters on every thread of a team of threads, the team that
+// solves with that many threads run on; NULL if none open. Reads add the
+// events counted so far, summed over the threads.
+PerfCounters *openPerfCounters(int threads);
+void readPerfCounters(PerfCounters *counters, double *events);
+void closePerfCounters(PerfCounters *counters);
+
+#endif
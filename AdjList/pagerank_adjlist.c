@@ -1,239 +1,400 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
+#include <unistd.h>
+#include "pagerank.h"
 
-#define DAMPING_FACTOR 0.85
-#define THRESHOLD 0.0001
-
-typedef struct Node
-{
-    int vertex;
-    struct Node *next;
-} Node;
-
-typedef struct
+// Prints how far ranks are from the double-precision baseline engine's ranks.
+void reportPrecisionError(Graph *g, const Options *options, double *ranks)
 {
-    int n;
-    int *outLinks;
-    Node **inLinks;
-} Graph;
-
-Graph *createGraph(int n)
-{
-    Graph *g = (Graph *)malloc(sizeof(Graph));
-    g->n = n;
-    g->outLinks = (int *)calloc(n, sizeof(int));
-    g->inLinks = (Node **)malloc(n * sizeof(Node *));
-
-    for (int i = 0; i < n; i++)
+    Options reference = *options;
+    reference.engine = ENGINE_BASELINE;
+    reference.startRanks = NULL;
+    reference.startIteration = 0;
+    double *expected = (double *)malloc(g->n * sizeof(double));
+    computePageRank(g, &reference, expected);
+
+    double maxError = 0.0, l1Error = 0.0;
+    int i;
+    #pragma omp parallel for shared(ranks, expected) private(i) reduction(max : maxError) reduction(+ : l1Error)
+    for (i = 0; i < g->n; i++)
     {
-        g->inLinks[i] = NULL;
+        double error = fabs(ranks[i] - expected[i]);
+        maxError = fmax(maxError, error);
+        l1Error += error;
     }
-    return g;
+    printf("Difference from double baseline: max = %e, L1 = %e\n", maxError, l1Error);
+    free(expected);
 }
 
-void addEdge(Graph *g, int u, int v)
+// Prints the iterations the Jacobi (fused) and Gauss-Seidel engines need to
+// reach the tolerance, both with the same schedule and threads.
+void reportJacobiIterations(Graph *g, const Options *options)
 {
-    Node *newNode = (Node *)malloc(sizeof(Node));
-    newNode->vertex = u;
-    newNode->next = g->inLinks[v];
-    g->inLinks[v] = newNode;
-    g->outLinks[u]++;
+    Options jacobi = *options, gaussSeidel = *options;
+    jacobi.engine = ENGINE_FUSED;
+    gaussSeidel.engine = ENGINE_GAUSS_SEIDEL;
+    int jacobiIterations = computePageRank(g, &jacobi, NULL).iterations;
+    int gaussSeidelIterations = computePageRank(g, &gaussSeidel, NULL).iterations;
+    printf("Iterations to reach the tolerance with %d threads: Jacobi = %d, Gauss-Seidel = %d\n",
+           options->threads, jacobiIterations, gaussSeidelIterations);
 }
 
-Graph *readGraphFromFile(const char *filename)
+// Solves, applies the batch in updateFile and compares repairing the ranks
+// incrementally with solving the updated graph from scratch.
+void reportIncrementalUpdate(Graph *g, const Options *options, const char *updateFile)
 {
-    int n, edges, u, v;
-    FILE *file = fopen(filename, "r");
-    if (!file)
+    EdgeBatch *batch = readEdgeBatch(g, updateFile);
+    if (!batch)
     {
-        printf("Error: Could not open file %s\n", filename);
-        return NULL;
+        return;
     }
-
-    if (fscanf(file, "%d %d", &n, &edges) != 2)
+    double *ranks = (double *)malloc(g->n * sizeof(double));
+    double *expected = (double *)malloc(g->n * sizeof(double));
+    computePageRank(g, options, ranks);
+
+    double start_time = omp_get_wtime();
+    Stats update = updatePageRankIncremental(g, batch, options, ranks);
+    double update_time = omp_get_wtime() - start_time;
+    if (update.iterations >= 0)
     {
-        printf("Error: Invalid file format.\n");
-        fclose(file);
-        return NULL;
-    }
+        start_time = omp_get_wtime();
+        Stats full = computePageRank(g, options, expected);
+        double full_time = omp_get_wtime() - start_time;
 
-    Graph *g = createGraph(n);
-    for (int i = 0; i < edges; i++)
-    {
-        if (fscanf(file, "%d %d", &u, &v) != 2 || u >= n || v >= n)
+        double maxError = 0.0;
+        for (int i = 0; i < g->n; i++)
         {
-            printf("Error: Invalid edge or out-of-bounds node.\n");
-            fclose(file);
-            return NULL;
+            maxError = fmax(maxError, fabs(ranks[i] - expected[i]));
         }
-        addEdge(g, u, v);
+        printf("Incremental update of %d edges: Time = %f, Edge Traversals = %lld\n", batch->count, update_time, update.edgeTraversals);
+        printf("Full recompute: Time = %f, Edge Traversals = %lld, Max difference = %e\n", full_time, full.edgeTraversals, maxError);
     }
-    fclose(file);
-    return g;
+
+    free(ranks);
+    free(expected);
+    freeEdgeBatch(batch);
 }
 
-void freeGraph(Graph *g)
+// Solves personalized PageRank for every seed set in seedFile, batchSize sets
+// per batched solve, or one at a time with the chosen engine if batchSize is 1.
+void reportPersonalized(Graph *g, const Options *options, const char *seedFile, int batchSize)
 {
-    for (int i = 0; i < g->n; i++)
+    SeedSets *sets = readSeedSets(g, seedFile);
+    if (!sets)
     {
-        Node *current = g->inLinks[i];
-        while (current)
-        {
-            Node *temp = current;
-            current = current->next;
-            free(temp);
-        }
+        return;
+    }
+    int k = batchSize < sets->count ? batchSize : sets->count;
+    double *teleports = (double *)malloc((size_t)g->n * k * sizeof(double));
+    double *ranks = (double *)malloc((size_t)g->n * k * sizeof(double));
+    Options single = *options;
+    single.teleport = teleports;
+    int mostIterations = 0;
+    long long edgeTraversals = 0;
+
+    double start_time = omp_get_wtime();
+    for (int first = 0; first < sets->count; first += k)
+    {
+        int count = sets->count - first < k ? sets->count - first : k;
+        seedTeleports(g, sets, first, count, teleports);
+        Stats stats = batchSize == 1 ? computePageRank(g, &single, ranks)
+                                     : computePageRankBatch(g, options, count, teleports, ranks);
+        mostIterations = stats.iterations > mostIterations ? stats.iterations : mostIterations;
+        edgeTraversals += stats.edgeTraversals;
     }
-    free(g->inLinks);
-    free(g->outLinks);
-    free(g);
+    double time_taken = omp_get_wtime() - start_time;
+    printf("Personalized PageRank for %d seed sets, %d per solve: Time = %f, Queries per second = %f, "
+           "Most Iterations = %d, Edge Traversals = %lld\n",
+           sets->count, k, time_taken, sets->count / time_taken, mostIterations, edgeTraversals);
+
+    free(teleports);
+    free(ranks);
+    freeSeedSets(sets);
 }
 
-void initializePageRank(Graph *g, double *opg)
+// Prints the k highest-ranked vertices by input ID, highest first.
+void printTopRanks(Graph *g, const double *ranks, int k)
 {
-    int i;
-    // Parallelize initialization since each node's PageRank value is independent.
-    #pragma omp parallel for shared(opg,g) private(i)
-    for (i = 0; i < g->n; i++)
+    k = k < g->n ? k : g->n;
+    int *top = (int *)malloc(k * sizeof(int));
+    selectTopRanks(ranks, g->n, k, top);
+    printf("Top %d vertices:\n", k);
+    for (int i = 0; i < k; i++)
     {
-        opg[i] = 1.0 / g->n;
+        printf("%d %d %.10e\n", i + 1, g->originalIds ? g->originalIds[top[i]] : top[i], ranks[top[i]]);
     }
+    free(top);
 }
 
-double computeDanglingContribution(Graph *g, double *opg)
+// Returns the best time per iteration over two solves; the first also warms
+// the caches and page tables.
+double timePerIteration(Graph *g, const Options *options)
 {
-    double dp = 0.0;
-    int p;
-    //  Parallelize sum computation across nodes with reduction to avoid race conditions.
-    #pragma omp parallel for shared(g, opg) reduction(+ : dp) private(p)
-    for (p = 0; p < g->n; p++)
+    double best = 0.0;
+    for (int run = 0; run < 2; run++)
     {
-        if (g->outLinks[p] == 0)
+        double start_time = omp_get_wtime();
+        Stats stats = computePageRank(g, options, NULL);
+        double time = (omp_get_wtime() - start_time) / (stats.iterations > 0 ? stats.iterations : 1);
+        if (run == 0 || time < best)
         {
-            dp += (DAMPING_FACTOR * opg[p]) / g->n;
+            best = time;
         }
     }
-    return dp;
+    return best;
 }
 
-void updatePageRank(Graph *g, double *opg, double *npg, double dp)
+// Prints the cost of reordering and the time per iteration it saves, both
+// graphs solved with the same engine and threads.
+void reportReordering(Graph *g, Graph *reordered, Ordering ordering, double reorderTime, const Options *options)
 {
-    // Parallelizing this ensures each node computes its new rank independently.
-    int ip,p;
-    Node *current;
-    #pragma omp parallel for shared(g, opg, npg, dp) private(p, current, ip)
-    for (p = 0; p < g->n; p++)
-    {
-        npg[p] = dp + (1.0 - DAMPING_FACTOR) / g->n;
-        current = g->inLinks[p];
-        while (current)
-        {
-            ip = current->vertex;
-            npg[p] += (DAMPING_FACTOR * opg[ip]) / g->outLinks[ip];
-            current = current->next;
-        }
+    Options measure = *options;
+    measure.checkpointFile = NULL;
+    double before_time = timePerIteration(g, &measure);
+    double after_time = timePerIteration(reordered, &measure);
+
+    printf("Reordered vertices by %s in %f s\n", orderingNames[ordering], reorderTime);
+    printf("Time per iteration with %d threads: %f -> %f (speedup %f)", options->threads, before_time, after_time, before_time / after_time);
+    if (after_time < before_time)
+    {
+        printf(", pays for itself after %.1f iterations\n", reorderTime / (before_time - after_time));
+    }
+    else
+    {
+        printf("\n");
     }
 }
 
-int hasConverged(double *opg, double *npg, int n)
+void printUsage(const char *program)
 {
-    int converged = 1;
-    int i;
-     // Parallel check for convergence
-    #pragma omp parallel for shared(opg, npg) reduction(&& : converged) private(i)
-    for (i = 0; i < n; i++)
+    printf("Usage: %s [-e engine] [-t threads] [-s schedule] [-H] [-k kernel] [-b KiB] [-N] [-p pinning] [-T k]\n"
+           "       [-d damping] [-x tolerance] [-m norm] [-I interval] [-O ordering] [-u updates]\n"
+           "       [-P seeds] [-K batch] [-c checkpoint] [-C interval] [-r checkpoint | -w checkpoint]\n"
+           "       graph iterations\n", program);
+    printf("  -e  engine:");
+    for (int i = 0; i < (int)(sizeof(engineNames) / sizeof(engineNames[0])); i++)
     {
-        if (fabs(npg[i] - opg[i]) > THRESHOLD)
-        {
-            converged = 0;
-        }
+        printf(" %s", engineNames[i]);
     }
-    return converged;
+    printf(" (default %s)\n", engineNames[ENGINE_BASELINE]);
+    printf("  -t  threads (default all)\n");
+    printSolverOptions();
+    printf("  -u  after the solve, apply \"+ u v\" / \"- u v\" edge updates from this file\n");
+    printf("      and compare the incremental rank repair with a full recompute\n");
+    printf("  -P  after the solve, compute personalized PageRank for each seed set in this\n");
+    printf("      file, one line of vertex IDs per set\n");
+    printf("  -K  seed sets solved together in one pass over the graph (default 16; 1 solves\n");
+    printf("      each with the chosen engine)\n");
+    printf("  -O  relabel vertices for locality before solving:");
+    for (int i = 0; i < (int)(sizeof(orderingNames) / sizeof(orderingNames[0])); i++)
+    {
+        printf(" %s", orderingNames[i]);
+    }
+    printf(" (default %s)\n", orderingNames[ORDER_NONE]);
+    printf("  -c  save the ranks to this checkpoint file at the end of each solve\n");
+    printf("  -C  also save them every this many iterations (default 0, only at the end)\n");
+    printf("  -r  resume from this checkpoint, continuing its iteration count\n");
+    printf("  -w  warm-start from the ranks in this checkpoint\n");
 }
 
-void computePageRank(Graph *g, int maxIterations, int threads)
+int main(int argc, char *argv[])
 {
-    omp_set_num_threads(threads);
-    double *opg = (double *)malloc(g->n * sizeof(double));
-    double *npg = (double *)malloc(g->n * sizeof(double));
-    int i;
-
-    initializePageRank(g, opg);
-
-    while (maxIterations > 0)
+    Options options;
+    const char *updateFile = NULL;
+    const char *seedFile = NULL;
+    int batchSize = 16;
+    const char *startFile = NULL;
+    int resume = 0;
+    Ordering ordering = ORDER_NONE;
+    int opt, index;
+
+    initOptions(&options);
+
+    while ((opt = getopt(argc, argv, "e:t:" SOLVER_OPTIONS "O:u:P:K:c:C:r:w:")) != -1)
     {
-        double dp = computeDanglingContribution(g, opg);
-        updatePageRank(g, opg, npg, dp);
-
-        if (hasConverged(opg, npg, g->n))
+        switch (opt)
         {
+        case 'e':
+            index = parseName(optarg, engineNames, sizeof(engineNames) / sizeof(engineNames[0]));
+            if (index < 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            options.engine = (Engine)index;
             break;
+        case 't':
+            options.threads = atoi(optarg);
+            if (options.threads <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'O':
+            index = parseName(optarg, orderingNames, sizeof(orderingNames) / sizeof(orderingNames[0]));
+            if (index < 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            ordering = (Ordering)index;
+            break;
+        case 'u':
+            updateFile = optarg;
+            break;
+        case 'P':
+            seedFile = optarg;
+            break;
+        case 'K':
+            batchSize = atoi(optarg);
+            if (batchSize <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'c':
+            options.checkpointFile = optarg;
+            break;
+        case 'C':
+            options.checkpointInterval = atoi(optarg);
+            if (options.checkpointInterval < 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'r':
+        case 'w':
+            if (startFile)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            startFile = optarg;
+            resume = opt == 'r';
+            break;
+        default:
+            if (parseSolverOption(&options, opt, optarg) <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
         }
-
-        // Parallel copying of npg to opg for the next iteration
-        #pragma omp parallel for shared(opg, npg) private(i)
-        for (i = 0; i < g->n; i++)
-        {
-            opg[i] = npg[i];
-        }
-
-        maxIterations--;
+    }
+    if (optind + 2 != argc || (options.maxIterations = atoi(argv[optind + 1])) <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
     }
 
-    // printf("PageRank values:\n");
-    // for (int i = 0; i < g->n; i++)
-    // {
-    //     printf("Node %d: %.6f\n", i, opg[i]);
-    // }
-
-    free(opg);
-    free(npg);
-}
-
-int main()
-{
-    char filename[100];
-    int iterations;
-    int thread_counts[] = {1, 2, 4, 6, 8, 10, 12, 16, 20, 32, 64};
-
-    printf("Enter the filename: ");
-    scanf("%s", filename);
-
-    Graph *g = readGraphFromFile(filename);
+    Graph *g = readGraph(argv[optind]);
     if (!g)
     {
         return 1;
     }
 
-    printf("Enter the number of iterations: ");
-    scanf("%d", &iterations);
-
-    FILE *fout = fopen("pagerank_results_5.csv", "w");
-    fprintf(fout, "Threads,Time,Speedup,Parallel Fraction\n");
+    int reduced = options.engine != ENGINE_BASELINE && RANK_PRECISION != PRECISION_DOUBLE;
+    double *ranks = reduced || options.topK > 0 ? (double *)malloc(g->n * sizeof(double)) : NULL;
+    if (options.engine != ENGINE_BASELINE)
+    {
+        printf("Using %s gather kernel with %s precision\n",
+               kernelNames[selectKernel(options.kernel)], precisionNames[RANK_PRECISION]);
+    }
+    if (options.engine == ENGINE_BLOCKED)
+    {
+        int segmentSize = 1 << segmentShiftFor(g->n, options.segmentBytes);
+        printf("Using segments of %d source vertices (%d segments)\n",
+               segmentSize, (int)(((long long)g->n + segmentSize - 1) / segmentSize));
+    }
 
-    double first_time = 0.0;
-    for (int j = 0; j < sizeof(thread_counts) / sizeof(thread_counts[0]); j++)
+    // Everything after this point works on the relabelled graph.
+    if (ordering != ORDER_NONE)
     {
-        int threads = thread_counts[j];
         double start_time = omp_get_wtime();
+        Graph *reordered = reorderGraph(g, ordering);
+        double reorder_time = omp_get_wtime() - start_time;
+        reportReordering(g, reordered, ordering, reorder_time, &options);
+        freeGraph(g);
+        g = reordered;
+    }
 
-        computePageRank(g, iterations, threads);
+    double *startRanks = NULL;
+    if (startFile)
+    {
+        double residual;
+        startRanks = readCheckpoint(g, startFile, resume, &options.startIteration, &residual);
+        if (!startRanks)
+        {
+            freeGraph(g);
+            return 1;
+        }
+        options.startRanks = startRanks;
+        if (resume)
+        {
+            printf("Resuming from iteration %d (residual %e)\n", options.startIteration, residual);
+        }
+    }
 
-        double end_time = omp_get_wtime();
-        double time_taken = end_time - start_time;
-        double speedup = (threads == 1) ? 1.0 : first_time / time_taken;
-        double parallel_fraction = (1 - (1 / speedup)) / (1 - (1.0 / threads));
+    Profile profile;
+    memset(&profile, 0, sizeof(profile));
+    if (PAGERANK_PROFILE)
+    {
+        profile.counters = openPerfCounters(options.threads);
+        profile.bandwidth = openBandwidthCounters();
+        options.profile = &profile;
+    }
 
-        if (threads == 1)
-            first_time = time_taken;
+    double start_time = omp_get_wtime();
+    Stats stats = computePageRank(g, &options, ranks);
+    double time_taken = omp_get_wtime() - start_time;
+    printf("Threads = %d, Time taken = %f, Iterations = %d, Edge Traversals = %lld, Residual = %e\n",
+           options.threads, time_taken, stats.iterations, stats.edgeTraversals, stats.residual);
+    if (options.profile)
+    {
+        printProfile(&profile);
+        freeProfile(&profile);
+        if (profile.counters)
+        {
+            closePerfCounters(profile.counters);
+        }
+        if (profile.bandwidth)
+        {
+            closeBandwidthCounters(profile.bandwidth);
+        }
+    }
 
-        fprintf(fout, "%d,%f,%f,%f\n", threads, time_taken, speedup, parallel_fraction);
-        printf("Threads = %d, Time taken = %f, Speedup = %f, Parallel Fraction = %f\n", threads, time_taken, speedup, parallel_fraction);
+    if (options.topK > 0)
+    {
+        printTopRanks(g, ranks, options.topK);
     }
 
-    fclose(fout);
+    // The reports below solve again and must not overwrite the checkpoint or
+    // the profile.
+    options.checkpointFile = NULL;
+    options.profile = NULL;
+    if (options.engine == ENGINE_GAUSS_SEIDEL)
+    {
+        reportJacobiIterations(g, &options);
+    }
+    if (updateFile)
+    {
+        reportIncrementalUpdate(g, &options, updateFile);
+    }
+    if (seedFile)
+    {
+        reportPersonalized(g, &options, seedFile, batchSize);
+    }
+    if (reduced)
+    {
+        reportPrecisionError(g, &options, ranks);
+    }
+    free(ranks);
+    free(startRanks);
     freeGraph(g);
     return 0;
 }
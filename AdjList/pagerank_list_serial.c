@@ -6,6 +6,58 @@
 #define DAMPING_FACTOR 0.85
 #define THRESHOLD 0.0001
 
+// List nodes are carved out of chunks of this size and released together.
+#define ARENA_CHUNK_BYTES (16 << 20)
+
+// Allocations are aligned to this, enough for the nodes' pointers.
+#define ARENA_ALIGN 8
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaChunk;
+
+// Bump allocator: each allocation takes the next bytes of the newest chunk,
+// and freeArena releases every chunk at once.
+typedef struct
+{
+    ArenaChunk *chunks;
+} Arena;
+
+void *arenaAlloc(Arena *arena, size_t bytes)
+{
+    ArenaChunk *chunk = arena->chunks;
+    size_t offset = chunk ? (chunk->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1) : 0;
+    if (!chunk || offset + bytes > chunk->size)
+    {
+        size_t size = bytes > ARENA_CHUNK_BYTES ? bytes : ARENA_CHUNK_BYTES;
+        chunk = (ArenaChunk *)malloc(sizeof(ArenaChunk) + size);
+        if (!chunk)
+        {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->size = size;
+        arena->chunks = chunk;
+        offset = 0;
+    }
+    chunk->used = offset + bytes;
+    return chunk->data + offset;
+}
+
+void freeArena(Arena *arena)
+{
+    while (arena->chunks)
+    {
+        ArenaChunk *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        free(chunk);
+    }
+}
+
 typedef struct Node
 {
     int vertex;
@@ -17,6 +69,7 @@ typedef struct
     int n;
     int *outLinks;
     Node **inLinks;
+    Arena nodes;
 } Graph;
 
 Graph *createGraph(int n)
@@ -25,13 +78,14 @@ Graph *createGraph(int n)
     g->n = n;
     g->outLinks = (int *)calloc(n, sizeof(int));
     g->inLinks = (Node **)malloc(n * sizeof(Node *));
+    g->nodes.chunks = NULL;
     for (int i = 0; i < n; i++)
         g->inLinks[i] = NULL;
     return g;
 }
 void addEdge(Graph *g, int u, int v)
 {
-    Node *newNode = (Node *)malloc(sizeof(Node));
+    Node *newNode = (Node *)arenaAlloc(&g->nodes, sizeof(Node));
     newNode->vertex = u;
     newNode->next = g->inLinks[v];
     g->inLinks[v] = newNode;
@@ -40,6 +94,14 @@ void addEdge(Graph *g, int u, int v)
     g->outLinks[u]++;
 }
 
+void freeGraph(Graph *g)
+{
+    freeArena(&g->nodes);
+    free(g->inLinks);
+    free(g->outLinks);
+    free(g);
+}
+
 Graph *readGraphFromFile(const char *filename)
 {
     int n, edges, u, v;
@@ -64,6 +126,7 @@ Graph *readGraphFromFile(const char *filename)
         {
             printf("Error: Invalid edge or out-of-bounds node.\n");
             fclose(file);
+            freeGraph(g);
             return NULL;
         }
         addEdge(g, u, v);
@@ -72,23 +135,6 @@ Graph *readGraphFromFile(const char *filename)
     return g;
 }
 
-void freeGraph(Graph *g)
-{
-    for (int i = 0; i < g->n; i++)
-    {
-        Node *current = g->inLinks[i];
-        while (current)
-        {
-            Node *temp = current;
-            current = current->next;
-            free(temp);
-        }
-    }
-    free(g->inLinks);
-    free(g->outLinks);
-    free(g);
-}
-
 void initializePageRank(Graph *g, double *opg)
 {
     #pragma omp parallel for
@@ -98,7 +144,7 @@ void initializePageRank(Graph *g, double *opg)
     }
 }
 
-double computeDanglingContribution(Graph *g, double *opg)
+double computeDanglingContribution(Graph *g, double *opg, double damping)
 {
     double dp = 0.0;
 
@@ -107,38 +153,38 @@ double computeDanglingContribution(Graph *g, double *opg)
     {
         if (g->outLinks[p] == 0)
         {
-            dp += (DAMPING_FACTOR * opg[p]) / g->n;
+            dp += (damping * opg[p]) / g->n;
         }
     }
     return dp;
 }
 
-void updatePageRank(Graph *g, double *opg, double *npg, double dp)
+void updatePageRank(Graph *g, double *opg, double *npg, double dp, double damping)
 {
     #pragma omp parallel for
     for (int p = 0; p < g->n; p++)
     {
-        npg[p] = dp + (1.0 - DAMPING_FACTOR) / g->n;
+        npg[p] = dp + (1.0 - damping) / g->n;
         Node *current = g->inLinks[p];
 
         while (current)
         {
             int ip = current->vertex;
             #pragma omp critical(pagerank_update)
-            npg[p] += (DAMPING_FACTOR * opg[ip]) / g->outLinks[ip];
+            npg[p] += (damping * opg[ip]) / g->outLinks[ip];
             current = current->next;
         }
     }
 }
 
-int hasConverged(double *opg, double *npg, int n)
+int hasConverged(double *opg, double *npg, int n, double tolerance)
 {
     int converged = 1;
 
     #pragma omp parallel for reduction(&& : converged)
     for (int i = 0; i < n; i++)
     {
-        if (fabs(npg[i] - opg[i]) > THRESHOLD)
+        if (fabs(npg[i] - opg[i]) > tolerance)
         {
             converged = 0;
         }
@@ -146,7 +192,7 @@ int hasConverged(double *opg, double *npg, int n)
     return converged;
 }
 
-void computePageRank(Graph *g, int maxIterations, int threads)
+void computePageRank(Graph *g, int maxIterations, int threads, double damping, double tolerance)
 {
     omp_set_num_threads(threads);
     double *opg = (double *)malloc(g->n * sizeof(double));
@@ -156,10 +202,10 @@ void computePageRank(Graph *g, int maxIterations, int threads)
 
     while (maxIterations > 0)
     {
-        double dp = computeDanglingContribution(g, opg);
-        updatePageRank(g, opg, npg, dp);
+        double dp = computeDanglingContribution(g, opg, damping);
+        updatePageRank(g, opg, npg, dp, damping);
 
-        if (hasConverged(opg, npg, g->n))
+        if (hasConverged(opg, npg, g->n, tolerance))
             break;
 
         #pragma omp parallel for
@@ -181,12 +227,21 @@ void computePageRank(Graph *g, int maxIterations, int threads)
     free(npg);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     char filename[100];
     int iterations;
+    // Optional arguments override the damping factor and the tolerance.
+    double damping = argc > 1 ? atof(argv[1]) : DAMPING_FACTOR;
+    double tolerance = argc > 2 ? atof(argv[2]) : THRESHOLD;
     int thread_counts[] = {1, 2, 4, 6, 8, 10, 12, 16, 20, 32, 64};
 
+    if (argc > 3 || !(damping >= 0.0 && damping < 1.0) || !(tolerance >= 0.0))
+    {
+        printf("Usage: %s [damping [tolerance]]\n", argv[0]);
+        return 1;
+    }
+
     printf("Enter the filename: ");
     scanf("%s", filename);
 
@@ -208,7 +263,7 @@ int main()
         int threads = thread_counts[j];
         double start_time = omp_get_wtime();
 
-        computePageRank(g, iterations, threads);
+        computePageRank(g, iterations, threads, damping, tolerance);
 
         double end_time = omp_get_wtime();
         double time_taken = end_time - start_time;
@@ -95,42 +95,42 @@ void initializePageRank(Graph *g, double *opg)
 }
 
 // Function to compute contribution from dangling nodes
-double computeDanglingContribution(Graph *g, double *opg)
+double computeDanglingContribution(Graph *g, double *opg, double damping)
 {
     double dp = 0.0;
     for (int p = 0; p < g->n; p++)
     {
         if (g->outLinks[p] == 0)
         {
-            dp += (DAMPING_FACTOR * opg[p]) / g->n;
+            dp += (damping * opg[p]) / g->n;
         }
     }
     return dp;
 }
 
 // Function to update PageRank values
-void updatePageRank(Graph *g, double *opg, double *npg, double dp)
+void updatePageRank(Graph *g, double *opg, double *npg, double dp, double damping)
 {
     for (int p = 0; p < g->n; p++)
     {
-        npg[p] = dp + (1.0 - DAMPING_FACTOR) / g->n;
+        npg[p] = dp + (1.0 - damping) / g->n;
 
         for (int ip = 0; ip < g->n; ip++)
         {
             if (g->inLinks[p][ip])
             {
-                npg[p] += (DAMPING_FACTOR * opg[ip]) / g->outLinks[ip];
+                npg[p] += (damping * opg[ip]) / g->outLinks[ip];
             }
         }
     }
 }
 
 // Function to check convergence
-int hasConverged(double *opg, double *npg, int n)
+int hasConverged(double *opg, double *npg, int n, double tolerance)
 {
     for (int i = 0; i < n; i++)
     {
-        if (fabs(npg[i] - opg[i]) > THRESHOLD)
+        if (fabs(npg[i] - opg[i]) > tolerance)
         {
             return 0; // Not yet converged
         }
@@ -139,7 +139,7 @@ int hasConverged(double *opg, double *npg, int n)
 }
 
 // Function to compute PageRank
-void computePageRank(Graph *g, int maxIterations)
+void computePageRank(Graph *g, int maxIterations, double damping, double tolerance)
 {
     double *opg = (double *)malloc(g->n * sizeof(double));
     double *npg = (double *)malloc(g->n * sizeof(double));
@@ -148,10 +148,10 @@ void computePageRank(Graph *g, int maxIterations)
 
     while (maxIterations > 0)
     {
-        double dp = computeDanglingContribution(g, opg);
-        updatePageRank(g, opg, npg, dp);
+        double dp = computeDanglingContribution(g, opg, damping);
+        updatePageRank(g, opg, npg, dp, damping);
 
-        if (hasConverged(opg, npg, g->n))
+        if (hasConverged(opg, npg, g->n, tolerance))
         {
             break;
         }
@@ -174,10 +174,19 @@ void computePageRank(Graph *g, int maxIterations)
     free(npg);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     char filename[100];
     int iterations;
+    // Optional arguments override the damping factor and the tolerance.
+    double damping = argc > 1 ? atof(argv[1]) : DAMPING_FACTOR;
+    double tolerance = argc > 2 ? atof(argv[2]) : THRESHOLD;
+
+    if (argc > 3 || !(damping >= 0.0 && damping < 1.0) || !(tolerance >= 0.0))
+    {
+        printf("Usage: %s [damping [tolerance]]\n", argv[0]);
+        return 1;
+    }
 
     printf("Enter the filename: ");
     scanf("%s", filename);
@@ -192,7 +201,7 @@ int main()
     scanf("%d", &iterations);
 
     clock_t start_time = clock();
-    computePageRank(g, iterations);
+    computePageRank(g, iterations, damping, tolerance);
     clock_t end_time = clock();
     double elapsed_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
 